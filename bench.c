@@ -0,0 +1,151 @@
+// Benchmark of the unrolled table kernels against the generic ones
+// Date: October 19, 2026
+
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "kernels.h"
+
+#define TABLE_SETS 64           // random tables cycled through while timing
+#define DEFAULT_ITERATIONS 2000000
+
+// one random snapshot of the manager tables
+typedef struct tableSet {
+    int allResources[NUM_RESOURCES];
+    tableIndex index;
+} tableSet;
+
+tableSet sets[TABLE_SETS];
+uint64_t rngState = 0x2545F4914F6CDD1DULL;
+volatile int sink = 0;
+
+// Function to get the next 64 random bits (xorshift64*)
+uint64_t nextRandom() {
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return rngState * 0x2545F4914F6CDD1DULL;
+}
+
+// Function to fill a table set the way a busy run looks, most processes hold a few
+// classes and some wait on a class that is used up
+void fillSet(tableSet* set) {
+    memset(set->allResources, 0, sizeof(set->allResources));
+    clearTables(&set->index);
+
+    for (int p = 0; p < MAX_PROCESSES; p++) {
+        int classes = nextRandom() % 4;
+        for (int k = 0; k < classes; k++) {
+            int c = nextRandom() % NUM_RESOURCES;
+            int amount = 1 + nextRandom() % 4;
+            if (set->allResources[c] + amount <= RESOURCE_INSTANCES) {
+                changeHolding(&set->index, c, p, amount);
+                set->allResources[c] += amount;
+            }
+        }
+    }
+
+    for (int p = 0; p < MAX_PROCESSES; p++) {
+        if (nextRandom() % 3 == 0) {
+            pushWaiter(&set->index, nextRandom() % NUM_RESOURCES, p, p);
+        }
+    }
+}
+
+// Function to get the monotonic time in nanoseconds
+double nowNano() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+// Function to time a detection kernel, nanoseconds per call
+double timeDetect(int (*kernel)(const tableIndex*, int, int*), long iterations) {
+    int deadlocked[MAX_PROCESSES];
+    int total = 0;
+    double start = nowNano();
+    for (long i = 0; i < iterations; i++) {
+        tableSet* set = &sets[i % TABLE_SETS];
+        total += kernel(&set->index, MAX_PROCESSES, deadlocked);
+    }
+    double elapsed = nowNano() - start;
+    sink += total;
+    return elapsed / iterations;
+}
+
+// Function to time a grant kernel, nanoseconds per call
+double timeGrant(int (*kernel)(const int*, const tableIndex*, int*), long iterations) {
+    int grantable[NUM_RESOURCES];
+    int total = 0;
+    double start = nowNano();
+    for (long i = 0; i < iterations; i++) {
+        tableSet* set = &sets[i % TABLE_SETS];
+        total += kernel(set->allResources, &set->index, grantable);
+    }
+    double elapsed = nowNano() - start;
+    sink += total;
+    return elapsed / iterations;
+}
+
+#ifdef UNROLLED_KERNELS
+// Function to check that both variants agree on every table set
+int checkKernels() {
+    for (int s = 0; s < TABLE_SETS; s++) {
+        tableSet* set = &sets[s];
+        int generic[MAX_PROCESSES], unrolled[MAX_PROCESSES];
+        if (detectDeadlockGeneric(&set->index, MAX_PROCESSES, generic) !=
+            detectDeadlockUnrolled(&set->index, MAX_PROCESSES, unrolled) ||
+            memcmp(generic, unrolled, sizeof(generic)) != 0) {
+            printf("detect kernels disagree on table set %d\n", s);
+            return 0;
+        }
+
+        int genericCount = grantableResourcesGeneric(set->allResources, &set->index, generic);
+        int unrolledCount = grantableResourcesUnrolled(set->allResources, &set->index, unrolled);
+        if (genericCount != unrolledCount || memcmp(generic, unrolled, sizeof(int) * genericCount) != 0) {
+            printf("grant kernels disagree on table set %d\n", s);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+#endif
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : DEFAULT_ITERATIONS;
+    if (iterations <= 0) {
+        printf("bench [iterations]\n");
+        exit(1);
+    }
+
+    for (int s = 0; s < TABLE_SETS; s++) {
+        fillSet(&sets[s]);
+    }
+
+    printf("shape %d resources x %d processes, %ld iterations\n", NUM_RESOURCES, MAX_PROCESSES, iterations);
+    printf("%-10s%-14s%-14s%-10s\n", "Kernel", "GenericNs", "UnrolledNs", "Speedup");
+
+#ifdef UNROLLED_KERNELS
+    if (!checkKernels()) {
+        exit(1);
+    }
+
+    double results[2][2] = {
+        {timeDetect(detectDeadlockGeneric, iterations), timeDetect(detectDeadlockUnrolled, iterations)},
+        {timeGrant(grantableResourcesGeneric, iterations), timeGrant(grantableResourcesUnrolled, iterations)},
+    };
+    const char* names[2] = {"detect", "grant"};
+    for (int k = 0; k < 2; k++) {
+        printf("%-10s%-14.2f%-14.2f%.2fx\n", names[k], results[k][0], results[k][1], results[k][0] / results[k][1]);
+    }
+#else
+    // no unrolled variant for this shape, oss uses the generic kernels
+    printf("%-10s%-14.2f%-14s%-10s\n", "detect", timeDetect(detectDeadlockGeneric, iterations), "-", "-");
+    printf("%-10s%-14.2f%-14s%-10s\n", "grant", timeGrant(grantableResourcesGeneric, iterations), "-", "-");
+#endif
+
+    return 0;
+}
@@ -10,126 +10,420 @@
 #include <stdlib.h>
 #include <sys/msg.h>
 #include <string.h>
+#include <math.h>
+#include <signal.h>
+#include <sched.h>
+#include "tables.h"
+#include "profile.h"
 
 // Globals
 unsigned int simClock[2];
 
-#define SHM_KEY 205431
-#define PERMS 0644
 
 typedef struct messages {
     long mtype; // allows the parent to know its receiving a message
-    int requestOrRelease; // 0 means request, 1 means release
+    int requestOrRelease; // 0 means request, 1 means release, REVOKE_MESSAGE takes one instance back
     int resourceType; // R0, R1, etc
     pid_t targetChild; // child that wants to release or request resource
 } messages;
 
-int queueID;  
+// oss sends this for each instance it takes back to break a deadlock
+#define REVOKE_MESSAGE 2
+
+int queueID = -1;  
 messages msgBuffer;   
 
-int lastDecisionCheck = 0;
-int lastTerminationCheck = 0;
-int terminationRequriementTime = 0;
+// simulated clock in the shared memory oss passes with -m
+volatile unsigned int* sharedClock = NULL;
+int sharedMemID = -1;
+
+// phase timings shared with oss, only attached when oss passes -P
+profilePhase* profile = NULL;
+int profileID = -1;
+
+// workload model, set from the spec oss passes with -w
+// the defaults reproduce the original uniform 10/90 behaviour
+typedef struct workload {
+    int popularity;              // POPULARITY_UNIFORM, _ZIPF or _HOTSPOT
+    double zipfSkew;             // exponent s, R0 is the most popular class
+    int hotClasses;              // R0..R(hotClasses - 1) are hot
+    int hotPercent;              // percent of requests that go to the hot classes
+    double classWeights[NUM_RESOURCES]; // per class request mix, overrides popularity
+    int hasClassMix;
+    int releasePercent;          // release chance per decision when hold times are off
+    unsigned long long holdNano; // mean exponential hold time, 0 turns it off
+    int arrival;                 // ARRIVAL_FIXED, _EXPONENTIAL or _BURSTY
+    unsigned long long decisionNano;  // (mean) time between decisions
+    int burstLength;             // decisions per burst
+    unsigned long long burstGapNano;  // idle time between bursts
+    int terminatePercent;        // termination chance per check
+    unsigned long long terminateNano; // time between termination checks
+    unsigned long long seed;     // 0 seeds from the clock and pid
+} workload;
+
+#define POPULARITY_UNIFORM 0
+#define POPULARITY_ZIPF 1
+#define POPULARITY_HOTSPOT 2
+
+#define ARRIVAL_FIXED 0
+#define ARRIVAL_EXPONENTIAL 1
+#define ARRIVAL_BURSTY 2
+
+workload model = {
+    POPULARITY_UNIFORM, 1.0, 2, 80, {0}, 0,
+    10, 0,
+    ARRIVAL_FIXED, 1000000, 8, 20000000,
+    10, 250000000, 0
+};
+
+// request weight of each class after the model is applied
+double requestWeights[NUM_RESOURCES];
+
+// decision and termination times in simulated nanoseconds
+unsigned long long startTime = 0;
+unsigned long long nextDecisionTime = 0;
+unsigned long long nextTerminationTime = 0;
+int burstRemaining = 0;
+
+// xorshift64* generator state, each worker process has its own
+uint64_t rngState = 0;
 
 // amount of resources the child has of each resource type
-// R0, R1, R2, R3, R4, R5, R6, R7, R8, R9
-int currentResources[10] = {0, 0, 0, 0, 0, 0, 0 ,0, 0 ,0};
+// R0, R1, R2, etc
+int currentResources[NUM_RESOURCES] = {0};
+
+// instances oss revoked from us, each is requested again before anything new
+int revokedResources[NUM_RESOURCES] = {0};
+
+// release deadline of every held instance when hold times are on
+unsigned long long heldUntil[NUM_RESOURCES][RESOURCE_INSTANCES];
+
+// shard processes that own the resource classes
+// resource class R(c) is served by the shard reading shardQueues[c % shardCount]
+int shardCount = 0;
+int shardQueues[MAX_SHARDS];
 
 // Function prototypes
 int timePassed();
+void readClock();
 void childTask();
 void childAction();
+void parseWorkload(const char* spec);
+void setupWorkload();
+uint64_t nextRandom();
+double nextUniform();
+unsigned long long nextExponential(unsigned long long mean);
+unsigned long long currentTime();
+void scheduleNextDecision(unsigned long long now);
+int pickRequestResource();
+int pickExpiredResource(unsigned long long now);
+void receiveMessage(messages* msg);
+void revokeResource(int resource);
+
+int main(int argc, char* argv[]) {
+    // check arguments
+    // -q and -m are the private message queue and shared memory ids from oss
+    // -S is the comma separated shard request queues and -w the workload spec
+    // -H is the instances held by a worker relaunched from a checkpoint, R0:R1:etc
+    // -P is the phase timing segment when oss is profiling
+    int argument;
+    while ((argument = getopt(argc, argv, "q:m:S:w:H:P:")) != -1) {
+        switch (argument) {
+            case 'q':
+                queueID = atoi(optarg);
+                break;
+            case 'm':
+                sharedMemID = atoi(optarg);
+                break;
+            case 'S': {
+                for (char* token = strtok(optarg, ","); token != NULL && shardCount < MAX_SHARDS; token = strtok(NULL, ",")) {
+                    shardQueues[shardCount] = atoi(token);
+                    shardCount += 1;
+                }
+                break;
+            }
+            case 'w':
+                parseWorkload(optarg);
+                break;
+            case 'H': {
+                int i = 0;
+                for (char* count = strtok(optarg, ":"); count != NULL && i < NUM_RESOURCES; count = strtok(NULL, ":")) {
+                    currentResources[i] = atoi(count);
+                    i += 1;
+                }
+                break;
+            }
+            case 'P':
+                profileID = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "worker: invalid arguments\n");
+                exit(1);
+        }
+    }
 
-int main(int argc, char const *argv[]) {
     // generate randomness
-    srand(time(NULL) + getpid());
+    setupWorkload();
 
-    // set up the message queue
-    key_t msgQueueKey = ftok("msgq.txt", 1);
-    if (msgQueueKey == -1) {
-        perror("Child failed to generate a in key using ftok.\n");
+    // check the message queue and attach to the clock once
+    if (queueID == -1 || sharedMemID == -1 || shardCount == 0) {
+        fprintf(stderr, "worker: needs the message queue, shared memory and shard queue ids from oss\n");
         exit(1);
     }
-    
-    queueID = msgget(msgQueueKey, PERMS);
-    if (queueID == -1) {
-        perror("Child failed to access the message queue.\n");
-        exit(1);
+
+    sharedClock = (volatile unsigned int*)shmat(sharedMemID, NULL, SHM_RDONLY);
+    if (sharedClock == (void*)-1) {
+        perror("Error: Failed to attach to shared memory using shmat.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // a dump request sent to the whole group is for oss
+    signal(SIGUSR1, SIG_IGN);
+    if (profileID != -1) {
+        profile = (profilePhase*)shmat(profileID, NULL, 0);
+        if (profile == (void*)-1) {
+            perror("Error: Failed to attach to the profile memory segment.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // instances we start with get a fresh hold time
+    readClock();
+    for (int i = 0; i < NUM_RESOURCES; i++) {
+        for (int k = 0; k < currentResources[i]; k++) {
+            heldUntil[i][k] = currentTime() + nextExponential(model.holdNano);
+        }
     }
 
     childTask();
     return 0;
 }
 
+// Function to read the key=value,key=value workload spec
+void parseWorkload(const char* spec) {
+    char copy[1024];
+    strncpy(copy, spec, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = '\0';
+
+    char* savePtr = NULL;
+    for (char* pair = strtok_r(copy, ",", &savePtr); pair != NULL; pair = strtok_r(NULL, ",", &savePtr)) {
+        char* value = strchr(pair, '=');
+        if (value == NULL) {
+            fprintf(stderr, "worker: workload setting '%s' has no value\n", pair);
+            exit(1);
+        }
+        *value = '\0';
+        value += 1;
+
+        if (strcmp(pair, "popularity") == 0) {
+            if (strcmp(value, "uniform") == 0) model.popularity = POPULARITY_UNIFORM;
+            else if (strcmp(value, "zipf") == 0) model.popularity = POPULARITY_ZIPF;
+            else if (strcmp(value, "hotspot") == 0) model.popularity = POPULARITY_HOTSPOT;
+            else {
+                fprintf(stderr, "worker: unknown popularity '%s'\n", value);
+                exit(1);
+            }
+        }
+        else if (strcmp(pair, "arrival") == 0) {
+            if (strcmp(value, "fixed") == 0) model.arrival = ARRIVAL_FIXED;
+            else if (strcmp(value, "exponential") == 0) model.arrival = ARRIVAL_EXPONENTIAL;
+            else if (strcmp(value, "bursty") == 0) model.arrival = ARRIVAL_BURSTY;
+            else {
+                fprintf(stderr, "worker: unknown arrival '%s'\n", value);
+                exit(1);
+            }
+        }
+        else if (strcmp(pair, "class_mix") == 0) {
+            // weights for R0, R1, etc separated by ':'
+            int i = 0;
+            char* weightSave = NULL;
+            for (char* weight = strtok_r(value, ":", &weightSave); weight != NULL && i < NUM_RESOURCES; weight = strtok_r(NULL, ":", &weightSave)) {
+                model.classWeights[i] = atof(weight);
+                i += 1;
+            }
+            model.hasClassMix = 1;
+        }
+        else if (strcmp(pair, "zipf_s") == 0) model.zipfSkew = atof(value);
+        else if (strcmp(pair, "hot_classes") == 0) model.hotClasses = atoi(value);
+        else if (strcmp(pair, "hot_pct") == 0) model.hotPercent = atoi(value);
+        else if (strcmp(pair, "release_pct") == 0) model.releasePercent = atoi(value);
+        else if (strcmp(pair, "hold_ns") == 0) model.holdNano = strtoull(value, NULL, 10);
+        else if (strcmp(pair, "decision_ns") == 0) model.decisionNano = strtoull(value, NULL, 10);
+        else if (strcmp(pair, "burst_len") == 0) model.burstLength = atoi(value);
+        else if (strcmp(pair, "burst_gap_ns") == 0) model.burstGapNano = strtoull(value, NULL, 10);
+        else if (strcmp(pair, "term_pct") == 0) model.terminatePercent = atoi(value);
+        else if (strcmp(pair, "term_ns") == 0) model.terminateNano = strtoull(value, NULL, 10);
+        else if (strcmp(pair, "seed") == 0) model.seed = strtoull(value, NULL, 10);
+        else {
+            fprintf(stderr, "worker: unknown workload setting '%s'\n", pair);
+            exit(1);
+        }
+    }
+}
+
+// Function to seed the generator and work out the request weight of each class
+void setupWorkload() {
+    // splitmix64 so nearby seeds still give unrelated streams
+    uint64_t seed = model.seed != 0 ? model.seed : (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+    seed += 0x9E3779B97F4A7C15ULL;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+    rngState = (seed ^ (seed >> 31)) | 1;
+
+    if (model.hotClasses < 1 || model.hotClasses > NUM_RESOURCES) {
+        model.hotClasses = 2;
+    }
+    if (model.burstLength < 1) {
+        model.burstLength = 1;
+    }
+    if (model.decisionNano == 0) {
+        model.decisionNano = 1;
+    }
+
+    for (int i = 0; i < NUM_RESOURCES; i++) {
+        if (model.hasClassMix) {
+            requestWeights[i] = model.classWeights[i];
+        }
+        else if (model.popularity == POPULARITY_ZIPF) {
+            requestWeights[i] = 1.0 / pow(i + 1, model.zipfSkew);
+        }
+        else if (model.popularity == POPULARITY_HOTSPOT) {
+            // hot classes share hotPercent of the requests, the rest share what is left
+            if (i < model.hotClasses) {
+                requestWeights[i] = model.hotPercent / (double)model.hotClasses;
+            }
+            else {
+                requestWeights[i] = (100 - model.hotPercent) / (double)(NUM_RESOURCES - model.hotClasses);
+            }
+        }
+        else {
+            requestWeights[i] = 1.0;
+        }
+    }
+
+    // a mix without any weight falls back to uniform
+    double totalWeight = 0;
+    for (int i = 0; i < NUM_RESOURCES; i++) {
+        totalWeight += requestWeights[i] > 0 ? requestWeights[i] : 0;
+    }
+    for (int i = 0; i < NUM_RESOURCES && totalWeight <= 0; i++) {
+        requestWeights[i] = 1.0;
+    }
+}
+
+// Function to get the next 64 random bits (xorshift64*)
+uint64_t nextRandom() {
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return rngState * 0x2545F4914F6CDD1DULL;
+}
+
+// Function to get a random double in [0, 1)
+double nextUniform() {
+    return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Function to get an exponentially distributed time with the given mean
+unsigned long long nextExponential(unsigned long long mean) {
+    return (unsigned long long)(-log(1.0 - nextUniform()) * mean);
+}
+
+// Function to get the simulated clock in nanoseconds
+unsigned long long currentTime() {
+    return (unsigned long long)simClock[0] * 1000000000ULL + simClock[1];
+}
+
+// Function to work out when the next request or release should happen
+void scheduleNextDecision(unsigned long long now) {
+    if (model.arrival == ARRIVAL_EXPONENTIAL) {
+        nextDecisionTime = now + nextExponential(model.decisionNano);
+    }
+    else if (model.arrival == ARRIVAL_BURSTY) {
+        // a burst of quick decisions, then a quiet gap
+        burstRemaining -= 1;
+        if (burstRemaining <= 0) {
+            burstRemaining = model.burstLength;
+            nextDecisionTime = now + model.burstGapNano;
+        }
+        else {
+            nextDecisionTime = now + model.decisionNano;
+        }
+    }
+    else {
+        nextDecisionTime = now + model.decisionNano;
+    }
+}
+
 // Function to update time and check for termination
 int timePassed() {
-    // after 250ms passes initially
-    // we can then precede to potentially terminate the program
-    if (simClock[1] >= 250000000 && terminationRequriementTime == 0) {
-        terminationRequriementTime = 1;
+    unsigned long long now = currentTime();
+
+    // the first clock read starts our timers
+    if (startTime == 0) {
+        startTime = now == 0 ? 1 : now;
+        nextTerminationTime = now + model.terminateNano;
+        burstRemaining = model.burstLength;
+        scheduleNextDecision(now);
     }
-    
-    if (terminationRequriementTime == 1 && ((simClock[1] >= lastTerminationCheck + 250000000) 
-    || (simClock[1] == 0 && simClock[0] >= 1))) 
+
+    // after the first termination interval passes
+    // we can then precede to potentially terminate the program
+    if (now >= nextTerminationTime) 
     {
-        // 10 % chance of termination
-        int randTerm = rand() % 101;
-        if (randTerm <= 10) {
+        if (nextUniform() * 100 < model.terminatePercent) {
             exit(0);
         }
-        lastTerminationCheck = simClock[1];
+        nextTerminationTime = now + model.terminateNano;
     }
 
-    // see if 1ms has passed because
+    // see if the decision time has passed because
     // thats when we can send a release or request to the parent
-    if (simClock[1] >= lastDecisionCheck + 1000000
-    || (simClock[1] == 0 && simClock[0] >= 1)) 
+    if (now >= nextDecisionTime) 
     {
-        lastDecisionCheck = simClock[1];
+        scheduleNextDecision(now);
         return 1;
     }
 
     return 0;
 }
 
+// Function to read the simulated clock from shared memory
+void readClock() {
+    // store the new simulated clock time
+    simClock[0] = sharedClock[0]; // seconds
+    simClock[1] = sharedClock[1]; // nanoseconds
+}
+
 // Function to update clock, check timer and get initial parent messages
 void childTask() { 
     // receive and send messages
+    // oss only sends the first go-ahead, after that each answer from a shard is the next one
+    receiveMessage(&msgBuffer);
     while (1) {
-        // Get message from parent
-        if (msgrcv(queueID, &msgBuffer, sizeof(msgBuffer), getpid(), 0) == -1) 
-        {
-            perror("Failed to receive a message in the child.\n");
-            exit(1);
-        }
-
         // check and wait to see if 1 ms has passed
         // afterward we can send a message back to the parent
+        // the whole wait is one sample, timing every poll would cost more than the poll
+        unsigned long long spinStart = profileStart(profile);
         while (1) {
             // update the clock
-            // Access and attach to shared memory
-            int sharedMemID = shmget(SHM_KEY, sizeof(int) * 2, 0777);
-                if (sharedMemID == -1) {
-                perror("Error: Failed to access shared memory using shmget.\n");
-                exit(EXIT_FAILURE);
-            }
-
-            int* sharedMemPtr = (int*)shmat(sharedMemID, NULL, SHM_RDONLY);
-            if (sharedMemPtr == NULL) {
-                perror("Error: Failed to attach to shared memory using shmat.\n");
-                exit(EXIT_FAILURE);
-            }
-
-            // store the new simulated clock time
-            simClock[0] = sharedMemPtr[0]; // seconds
-            simClock[1] = sharedMemPtr[1]; // nanoseconds
-            shmdt(sharedMemPtr);
+            readClock();
 
             if (timePassed() == 1) 
             {
+                profileEnd(profile, PHASE_WORKER_SPIN, spinStart);
+
                 // release or request a resource
-                int choice = rand() % 101;
-                if (choice <= 10) {
+                // with hold times on we release exactly the instances whose time is up
+                int release;
+                if (model.holdNano > 0) {
+                    release = pickExpiredResource(currentTime()) != -1;
+                }
+                else {
+                    release = nextUniform() * 100 < model.releasePercent;
+                }
+
+                if (release) {
                     // Set requestOrRelease parameter to 1 for release
                     childAction(1);
                 }
@@ -139,6 +433,10 @@ void childTask() {
                 }
                 break;
             }
+
+            // hand the core back while we wait, the clock only moves when oss or
+            // the shards get to run and a busy poll starves them when cores are short
+            sched_yield();
         }
     }
 }
@@ -150,9 +448,9 @@ void childAction(int requestOrRelease) {
     {
         // check if there are any resources that we can release
         // because its possible that there isn't any currently
-        int releaseableResources[10];
+        int releaseableResources[NUM_RESOURCES];
         int canReleaseResource = 0;
-        for (int i=0; i<10; i++) {
+        for (int i=0; i<NUM_RESOURCES; i++) {
             if (currentResources[i] != 0) {
                 releaseableResources[canReleaseResource] = i; 
                 canReleaseResource += 1; 
@@ -164,65 +462,162 @@ void childAction(int requestOrRelease) {
             // request a resource instead
             // because we dont have any to release
             msgBuffer.requestOrRelease = 0;
-            msgBuffer.resourceType = rand() % 10; // R0, R1, R2, .. R9 
+            msgBuffer.resourceType = pickRequestResource();
         }
         else {
-            // get random resource to release
-            int randResource = releaseableResources[rand() % canReleaseResource];
-            msgBuffer.resourceType = randResource;
+            // release the instance whose hold time ran out, or a random one
+            int expiredResource = model.holdNano > 0 ? pickExpiredResource(currentTime()) : -1;
+            if (expiredResource != -1) {
+                msgBuffer.resourceType = expiredResource;
+            }
+            else {
+                msgBuffer.resourceType = releaseableResources[nextRandom() % canReleaseResource];
+            }
             msgBuffer.requestOrRelease = requestOrRelease;
         }
     }
     else 
     {
-        // check if there are any resources that we can request
-        // because its possible that there isn't any left
-        int requestableResources[10];
-        int canRequestResource = 0;
-        for (int i=0; i<10; i++) {
-            if (currentResources[i] != 20) {
-                requestableResources[canRequestResource] = i;
-                canRequestResource += 1;
-            }
-        }
+        // get a resource to request using the workload popularity
+        // its possible that there isn't any left we can request
+        int requestResource = pickRequestResource();
 
-        if (canRequestResource == 0)
+        if (requestResource == -1)
         {
             // release a resource instead
             // because we cant request any
-            msgBuffer.requestOrRelease = 1;
-            msgBuffer.resourceType = rand() % 10; // R0, R1, R2, .. R9 
+            childAction(1);
+            return;
         }
         else 
         {
-            // get random resource to request
-            int randResource = requestableResources[rand() % canRequestResource];
-            msgBuffer.resourceType = randResource;
+            msgBuffer.resourceType = requestResource;
             msgBuffer.requestOrRelease = requestOrRelease;
         }        
     }
 
     // Send and receive messages as before
-    msgBuffer.mtype = getppid();
+    // the owning shard answers instead of the parent,
+    // each shard reads its own queue so the type only has to be positive
+    int sendQueue = shardQueues[msgBuffer.resourceType % shardCount];
+    msgBuffer.mtype = 1;
     msgBuffer.targetChild = getpid();
-    if (msgsnd(queueID, &msgBuffer, sizeof(messages) - sizeof(long), 0) == -1) {
+    unsigned long long sendStart = profileStart(profile);
+    if (msgsnd(sendQueue, &msgBuffer, sizeof(messages) - sizeof(long), 0) == -1) {
         perror("msgsnd to parent failed\n");
         exit(1);
     }
+    profileEnd(profile, PHASE_WORKER_SEND, sendStart);
 
     // Wait for message back from parent
+    // a deadlocked request can have instances revoked while it waits
     messages msgBackFromParent;
-    if (msgrcv(queueID, &msgBackFromParent, sizeof(messages), getpid(), 0) == -1) {
-        perror("Error couldn't receive message in parent\n");
-        exit(1);
-    }
+    unsigned long long replyStart = profileStart(profile);
+    receiveMessage(&msgBackFromParent);
+    profileEnd(profile, PHASE_WORKER_REPLY, replyStart);
 
     // Update resource amount
     // check decision and update child current resources
+    int resource = msgBuffer.resourceType;
     if (msgBuffer.requestOrRelease == 0) {
-        currentResources[msgBuffer.resourceType] += 1;
+        // the hold time starts when the grant arrives
+        readClock();
+        heldUntil[resource][currentResources[resource]] = currentTime() + nextExponential(model.holdNano);
+        currentResources[resource] += 1;
     } 
     else {
-        currentResources[msgBuffer.resourceType] -= 1;
+        // drop the instance that was due first
+        int earliest = 0;
+        for (int k = 1; k < currentResources[resource]; k++) {
+            if (heldUntil[resource][k] < heldUntil[resource][earliest]) {
+                earliest = k;
+            }
+        }
+        currentResources[resource] -= 1;
+        heldUntil[resource][earliest] = heldUntil[resource][currentResources[resource]];
     } 
-}
\ No newline at end of file
+}
+
+// Function to pick a resource to request, weighted by the workload popularity
+// returns -1 when there is nothing left we can request
+int pickRequestResource() {
+    // take back what oss revoked first
+    for (int i = 0; i < NUM_RESOURCES; i++) {
+        if (revokedResources[i] > 0 && currentResources[i] != RESOURCE_INSTANCES) {
+            revokedResources[i] -= 1;
+            return i;
+        }
+    }
+
+    double totalWeight = 0;
+    for (int i = 0; i < NUM_RESOURCES; i++) {
+        if (currentResources[i] != RESOURCE_INSTANCES) {
+            totalWeight += requestWeights[i];
+        }
+    }
+
+    if (totalWeight <= 0) {
+        return -1;
+    }
+
+    double target = nextUniform() * totalWeight;
+    int lastRequestable = -1;
+    for (int i = 0; i < NUM_RESOURCES; i++) {
+        if (currentResources[i] == RESOURCE_INSTANCES || requestWeights[i] <= 0) {
+            continue;
+        }
+
+        lastRequestable = i;
+        target -= requestWeights[i];
+        if (target < 0) {
+            return i;
+        }
+    }
+
+    // rounding can leave a sliver of weight at the end
+    return lastRequestable;
+}
+
+// Function to find the resource whose hold time ran out first
+// returns -1 when nothing we hold is due yet
+int pickExpiredResource(unsigned long long now) {
+    int expiredResource = -1;
+    unsigned long long earliest = now;
+    for (int i = 0; i < NUM_RESOURCES; i++) {
+        for (int k = 0; k < currentResources[i]; k++) {
+            if (heldUntil[i][k] <= earliest) {
+                earliest = heldUntil[i][k];
+                expiredResource = i;
+            }
+        }
+    }
+
+    return expiredResource;
+}
+
+// Function to wait for our next message from oss
+// revoke messages are applied here, so callers only see grants and go-aheads
+void receiveMessage(messages* msg) {
+    while (1) {
+        if (msgrcv(queueID, msg, sizeof(messages), getpid(), 0) == -1) {
+            perror("Failed to receive a message in the child.\n");
+            exit(1);
+        }
+
+        if (msg->requestOrRelease != REVOKE_MESSAGE) {
+            return;
+        }
+        revokeResource(msg->resourceType);
+    }
+}
+
+// Function to give up one instance oss took back and remember to ask for it again
+void revokeResource(int resource) {
+    if (currentResources[resource] == 0) {
+        return;
+    }
+
+    // the newest instance goes, its hold time starts over when it is granted again
+    currentResources[resource] -= 1;
+    revokedResources[resource] += 1;
+}
@@ -0,0 +1,136 @@
+// Detection, grant and release kernels over the allocation tables
+// Date: October 19, 2026
+
+// the common table shapes get unrolled variants with constant loop bounds that work on
+// the process bit words, any other shape uses the generic variants which walk the sparse lists
+// the variant is picked at build time in tables.h, define GENERIC_KERNELS to force the generic one
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdint.h>
+#include "tables.h"
+
+// find the processes that can never finish
+// a waiting process can finish once any other holder of its resource can, anyone not waiting can release
+// fills deadlocked for the first processes slots and returns how many are deadlocked
+static inline int detectDeadlockGeneric(const tableIndex* index, int processes, int* deadlocked) {
+    int finished[MAX_PROCESSES];
+    for (int p = 0; p < processes; p++) {
+        finished[p] = index->processes[p].waitingFor == -1;
+    }
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int p = 0; p < processes; p++) {
+            if (finished[p] == 1) {
+                continue;
+            }
+
+            int c = index->processes[p].waitingFor;
+            for (int h = index->firstHolder[c]; h != -1; h = index->holdings[h].nextHolder) {
+                int q = index->holdings[h].process;
+                if (q != p && finished[q] == 1) {
+                    finished[p] = 1;
+                    changed = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    int deadlockedCount = 0;
+    for (int p = 0; p < processes; p++) {
+        deadlocked[p] = finished[p] == 0;
+        deadlockedCount += deadlocked[p];
+    }
+
+    return deadlockedCount;
+}
+
+// collect the resources that have a waiter and a free instance, in index order
+static inline int grantableResourcesGeneric(const int* allResources, const tableIndex* index, int* grantable) {
+    int count = 0;
+    for (int c = 0; c < NUM_RESOURCES; c++) {
+        if (index->waiterCount[c] > 0 && allResources[c] < RESOURCE_INSTANCES) {
+            grantable[count++] = c;
+        }
+    }
+
+    return count;
+}
+
+// take every instance a process holds back into the pool and free its holdings
+// classes gets each resource it held and released the amount, returns how many classes
+// there is no unrolled variant, the held list is already only as long as what is held
+static inline int releaseColumn(int* allResources, tableIndex* index, int process, int* classes, int* released) {
+    int count = 0;
+    while (index->processes[process].firstHeld != -1) {
+        int h = index->processes[process].firstHeld;
+        int c = index->holdings[h].resource;
+        classes[count++] = c;
+        released[c] = index->holdings[h].amount;
+        allResources[c] -= released[c];
+        freeHolding(index, h);
+    }
+
+    return count;
+}
+
+#ifdef UNROLLED_KERNELS
+
+// same result as detectDeadlockGeneric, over the holder and waiter bit words
+// every listed shape fits its processes in one word, and a waiting process is never
+// in the finished word so it never counts as its own holder
+static inline int detectDeadlockUnrolled(const tableIndex* index, int processes, int* deadlocked) {
+    uint64_t waiting = 0;
+    #pragma GCC unroll 32
+    for (int c = 0; c < NUM_RESOURCES; c++) {
+        waiting |= index->waiterMask[c];
+    }
+
+    // everyone waiting on a resource finishes once any holder of it has
+    uint64_t finished = ~waiting;
+    uint64_t before;
+    do {
+        before = finished;
+        #pragma GCC unroll 32
+        for (int c = 0; c < NUM_RESOURCES; c++) {
+            finished |= index->waiterMask[c] & -(uint64_t)((index->holderMask[c] & finished) != 0);
+        }
+    } while (finished != before);
+
+    uint64_t stuck = waiting & ~finished;
+    #pragma GCC unroll 64
+    for (int p = 0; p < MAX_PROCESSES; p++) {
+        deadlocked[p] = (stuck >> p) & 1;
+    }
+
+    (void)processes;
+    return __builtin_popcountll(stuck);
+}
+
+// same result as grantableResourcesGeneric without a branch per resource
+static inline int grantableResourcesUnrolled(const int* allResources, const tableIndex* index, int* grantable) {
+    int count = 0;
+    #pragma GCC unroll 32
+    for (int c = 0; c < NUM_RESOURCES; c++) {
+        grantable[count] = c;
+        count += (index->waiterCount[c] > 0) & (allResources[c] < RESOURCE_INSTANCES);
+    }
+
+    return count;
+}
+
+#define detectDeadlock      detectDeadlockUnrolled
+#define grantableResources  grantableResourcesUnrolled
+
+#else
+
+#define detectDeadlock      detectDeadlockGeneric
+#define grantableResources  grantableResourcesGeneric
+
+#endif
+
+#endif
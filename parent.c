@@ -16,21 +16,31 @@
 #include <sys/ipc.h>
 #include <sys/msg.h>
 #include <sys/shm.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include "kernels.h"
+#include "profile.h"
 
-#define SHM_KEY 205431  
-#define PERMS 0644     
+#define PERMS 0600     
 
 unsigned int simClock[2] = {0, 0};
 
 // message queue structure
 typedef struct messages {
     long mtype;
-    int requestOrRelease; // 0 means request, 1 means release
+    int requestOrRelease; // 0 means request, 1 means release, REVOKE_MESSAGE takes one instance back
     int resourceType; // R0, R1, etc
     pid_t targetChild; // child that wants to release or request resource
 } messages;
 
-int msgqId; // message queue ID
+// oss sends this to a worker for each instance it takes back by preemption
+#define REVOKE_MESSAGE 2
+
+int msgqId = -1; // message queue ID, -1 until it is made
 messages buffer; // message queue Buffer
 
 // Process Control Block structure
@@ -42,12 +52,136 @@ typedef struct PCB {
     int startNano; // time when it was created
 } process_PCB;
 
-struct PCB childTable[18];
-
-unsigned shmID;             
-unsigned* shmPtr; 
+// latency histogram buckets, bucket b holds [2^(b-1), 2^b) nanoseconds and bucket 0 holds 0
+#define LATENCY_BUCKETS 48
+
+// run statistics for each process slot
+typedef struct processStats {
+    int requests;
+    int grants;
+    int blockedGrants; // grants that had to wait in the queue
+    int releases;
+    int killed;        // removed as a deadlock victim
+    int exited;        // terminated on its own
+    int peakHeld;      // most instances held at once
+    int held;
+    int revoked;       // instances taken back by preemption
+    unsigned long long blockedNano; // time spent waiting in the queue
+    unsigned long long requestTime; // when the waiting request was made
+    unsigned long long endTime;     // when it exited or was killed
+} processStats;
+
+// run statistics for each resource class
+typedef struct resourceStats {
+    int requests;
+    int grants;
+    int blocked;   // requests that went into the wait queue
+    int releases;
+    int peakInUse;
+    unsigned long long busyArea;   // sum of instances in use times nanoseconds
+    unsigned long long lastChange; // last time the in use count changed
+} resourceStats;
+
+// run statistics collected as events happen
+typedef struct runStats {
+    processStats processes[MAX_PROCESSES];
+    resourceStats resources[NUM_RESOURCES];
+    unsigned long long grantLatency[LATENCY_BUCKETS]; // updated by several shards
+    unsigned long long maxGrantLatency;
+    unsigned long long totalGrantLatency;
+    unsigned long long waitLatency[LATENCY_BUCKETS];  // only grants that had to wait
+    unsigned long long waitedGrants;
+    unsigned long long totalWaitLatency;
+    int detectionRuns;
+    int deadlocksFound;
+    int victims;
+    int preemptions;      // deadlocks broken by revoking instances instead of killing
+    int revokedInstances;
+} runStats;
+
+// manager state kept in shared memory so shard processes can serve requests
+// the clock must stay first because the workers read it as two unsigned values
+typedef struct sharedState {
+    unsigned clock[2];
+    struct PCB childTable[MAX_PROCESSES];
+    int allResources[NUM_RESOURCES];
+    tableIndex index;  // sparse allocation and request tables
+    pthread_mutex_t shardLocks[MAX_SHARDS]; // one lock per shard's resource rows
+    runStats stats;
+} sharedState;
+
+// checkpoint file layout
+// two slots are written in turn and current only moves once a slot is complete,
+// so a crash while writing one still leaves the other to restart from
+#define CHECKPOINT_MAGIC 0x3154504B4353534FULL // "OSSCKPT1" in file order
+#define CHECKPOINT_VERSION 5
+
+// the table layout also depends on the kernel variant, see tables.h
+#ifdef UNROLLED_KERNELS
+#define CHECKPOINT_KERNELS 1
+#else
+#define CHECKPOINT_KERNELS 0
+#endif
+
+// manager state outside shared memory that a restart needs
+typedef struct checkpointCounters {
+    int processCount;
+    int simultaneousCount;
+    int processSpawnRate;
+    int totalLaunched;
+    int totalTerminated;
+    unsigned long long launchTimePassed;
+    int oneSecondPassed;
+    int quarterSecondPassed;
+    int grantPolicy;
+    double agingFactor;
+    int resolution;
+    char workloadSpec[1024];
+    unsigned long long workloadSeed;
+} checkpointCounters;
+
+typedef struct checkpointSlot {
+    unsigned long long sequence; // 0 while the slot is being written
+    checkpointCounters counters;
+    sharedState state;           // the shard locks in here are not restored
+} checkpointSlot;
+
+// what the running oss has made, kept up to date as it goes rather than per checkpoint
+// SysV objects outlive a killed oss and its workers are orphaned, so a restart removes them
+typedef struct checkpointOwner {
+    pid_t pid;                   // oss that made everything below, 0 once it has cleaned up
+    int msgqId;
+    int shmID;
+    int profileID;
+    time_t msgqCreated;          // msg_ctime of each queue, a reused id has another
+    int shardQueueCount;
+    int shardQueues[MAX_SHARDS];
+    time_t shardQueueCreated[MAX_SHARDS];
+    pid_t shardPids[MAX_SHARDS];
+    unsigned long long shardStarts[MAX_SHARDS];   // start time of each pid, a reused pid has another
+    pid_t workerPids[MAX_PROCESSES];              // 0 once the worker is reaped
+    unsigned long long workerStarts[MAX_PROCESSES];
+} checkpointOwner;
+
+typedef struct checkpointFile {
+    unsigned long long magic;
+    int version;
+    int numResources;            // the table shape must match to restart
+    int maxProcesses;
+    int resourceInstances;
+    int kernels;                 // CHECKPOINT_KERNELS of the build that wrote it
+    unsigned long long fileSize; // sizeof(checkpointFile) of the build that wrote it
+    int current;                 // slot with the latest complete checkpoint, -1 when none
+    checkpointOwner owner;
+    checkpointSlot slots[2];
+} checkpointFile;
+
+int shmID = -1;             // -1 until the segment is made
+unsigned* shmPtr = NULL; 
+sharedState* state;
 
 char* filename = NULL; // logfile.txt
+char workerPath[4096] = "./worker"; // the worker binary sits next to oss
 int processCount;      
 int simultaneousCount; 
 int processSpawnRate;  
@@ -65,31 +199,169 @@ int totalLaunched = 0;
 int totalTerminated = 0;
 unsigned long long launchTimePassed = 0;
 
-// resources and allocated tables
-int allocatedMatrix[10][18];
-int requestMatrix[10][18];
-int allResources[10];
+// real time mode variables
+// simulated time is the monotonic time since start times the speed factor
+// and the main loop sleeps on a timerfd tick instead of spinning
+double realTimeSpeed = 0; // 0 means the classic 0.1ms per loop clock
+long realTimeTickNano = 100000; // wall time between loop iterations, set with -T
+int tickFd = -1;
+struct timespec realTimeStart;
+
+// checkpoint variables
+// the checkpoint file is mapped shared, so a checkpoint is a copy into memory and
+// the kernel writes it out in the background
+char* checkpointName = NULL;
+int checkpointFd = -1;         // held open for the lock on the file, see openCheckpoint
+checkpointFile* checkpoint = NULL;
+double checkpointInterval = 1; // simulated seconds between checkpoints
+unsigned long long nextCheckpointNano = 0;
+unsigned long long checkpointSequence = 0;
+int checkpointsWritten = 0;
+double checkpointPauseNano = 0;
+int restartRun = 0;            // resume from the checkpoint instead of starting over
+unsigned long long realTimeBase = 0; // simulated time the real time clock starts from
+
+// profiling variables
+// the phase table is its own shared segment so the workers can add to it
+const char* phaseNames[PHASE_COUNT] = {
+    "loop", "clock", "launch", "reap", "handle", "dispatch", "detect", "checkpoint",
+    "display", "lock", "msgsnd", "waitpid", "fopen", "worker spin", "worker send", "worker reply",
+};
+int profiling = 0;
+profilePhase* profile = NULL;  // NULL when profiling is off
+int profileID = -1;
+volatile sig_atomic_t profileDumpRequested = 0;
+
+// resources and allocated tables (point into shared state)
+struct PCB* childTable;
+int* allResources;
+tableIndex* tables;
+
+// run statistics (point into shared state)
+runStats* stats;
+struct timespec wallStart;
+volatile sig_atomic_t stopRequested = 0;
+
+// sharding variables
+// resource class R(c) is owned by shard c % shardCount
+int shardCount = 1;
+int shardIndex = -1; // -1 in the coordinator, otherwise this shard's number
+pid_t shardPids[MAX_SHARDS];
+int shardQueues[MAX_SHARDS]; // request queue of each shard, answers still go out on msgqId
+int shardQueueCount = 0;     // shard queues made so far, for cleanup
+
+// grant policy variables
+// a waiting request's key is its policy priority plus agingFactor times its request time
+// every waiter ages at the same rate, so the key never has to change while it waits
+#define POLICY_INDEX 0 // lowest process index first
+#define POLICY_WAIT 1  // longest waiting first
+#define POLICY_AGE 2   // oldest process first
+#define POLICY_HELD 3  // fewest instances held first
+const char* policyNames[] = {"index", "wait", "age", "held"};
+int grantPolicy = POLICY_INDEX;
+double agingFactor = -1; // -1 uses the policy default, 0 for index and 1 otherwise
+double indexWeight = 1e9; // nanoseconds of waiting worth one process index
+double heldWeight = 1e8;  // nanoseconds of waiting worth one held instance
+
+// deadlock resolution variables
+// preempt revokes only the instances the other deadlocked processes wait on,
+// the worker keeps running and requests them again later
+#define RESOLVE_KILL 0
+#define RESOLVE_PREEMPT 1
+const char* resolutionNames[] = {"kill", "preempt"};
+int resolution = RESOLVE_KILL;
+
+// workload spec forwarded to every worker as key=value,key=value
+// a seed in the profile gives worker n the seed workloadSeed + n
+char workloadSpec[1024] = "";
+unsigned long long workloadSeed = 0;
+
+// built in workload profiles, anything else given to -w is read as a profile file
+const char* workloadProfiles[][2] = {
+    {"uniform", ""},
+    {"zipf", "popularity=zipf,zipf_s=1.0"},
+    {"hotspot", "popularity=hotspot,hot_classes=2,hot_pct=80"},
+    {"bursty", "arrival=bursty,burst_len=8,burst_gap_ns=20000000,hold_ns=50000000"},
+};
+
+// settings a worker understands, checked here so typos fail before launching
+const char* workloadKeys[] = {
+    "popularity", "zipf_s", "hot_classes", "hot_pct", "class_mix", "release_pct", "hold_ns",
+    "arrival", "decision_ns", "burst_len", "burst_gap_ns", "term_pct", "term_ns", "seed",
+};
 
 // Function prototypes
 void showResourceTables();
+void showResourceHeader(FILE* out);
 void showProcessTable();
 void launchChildren();
 void checkChildMessage();
 void sendChildMessage(int i);
-void incrementSimulatedClock();
+pid_t startWorker(int slot, const char* heldArg);
+unsigned long long incrementSimulatedClock();
 void handleTermination();
 void runDetectionAlgorithm();
+void launchShards();
+void runShard();
+void lockShard(int shard);
+void unlockShard(int shard);
+void lockAllShards();
+void unlockAllShards();
+void loadWorkload(const char* profile);
+void addWorkloadSetting(char* setting);
+int validWorkloadValue(const char* key, const char* value);
+void requestStop(int sig);
+unsigned long long simulatedNano();
+int latencyBucket(unsigned long long nano);
+void noteResourceUse(int resource);
+void recordGrant(int process, int resource, unsigned long long waited);
+void recordRelease(int process, int resource, int amount);
+void recordProcessEnd(int process, int killed);
+void writeReport();
+unsigned long long latencyPercentile(unsigned long long* histogram, double fraction);
+void changeAllocation(int resource, int process, int amount);
+void addWaiter(int resource, int process);
+void removeWaiter(int process);
+double grantPriority(int process);
+void releaseProcessResources(int process, FILE* file, const char* format);
+int preemptDeadlock(int* deadlocked, FILE* file);
+void sendRevokeMessage(int process, int resource);
+void recordRevoke(int process, int resource, int amount);
+void startRealTimeClock();
+void waitForTick();
+void openCheckpoint();
+void writeCheckpoint();
+void restoreCheckpoint();
+void recordOwnedIds();
+void clearStaleRun();
+void forgetWorker(int slot);
+unsigned long long processStart(pid_t pid);
+time_t queueCreated(int id);
+void relaunchWorkers();
+FILE* openLogFile();
+void sendMessage(messages* msg);
+void requestProfileDump(int sig);
+void writeProfile();
 
 int main(int argc, char** argv) {
     // register signal handlers for interruption and timeout
+    // the main loop does the shutdown so the report is not written from a handler
     srand(time(NULL) + getpid());
-    signal(SIGINT, handleTermination);
-    signal(SIGALRM, handleTermination);
+    signal(SIGINT, requestStop);
+    signal(SIGALRM, requestStop);
     alarm(5); 
+    clock_gettime(CLOCK_MONOTONIC, &wallStart);
+
+    // exec the worker from the directory oss was started from, not the current one,
+    // so oss can be run by path from anywhere, e.g. by sweep -x
+    char* lastSlash = strrchr(argv[0], '/');
+    if (lastSlash != NULL) {
+        snprintf(workerPath, sizeof(workerPath), "%.*s/worker", (int)(lastSlash - argv[0]), argv[0]);
+    }
 
     // check arguments
     char argument;
-    while ((argument = getopt(argc, argv, "f:hn:s:t:")) != -1) {
+    while ((argument = getopt(argc, argv, "f:hn:s:t:S:w:r:T:p:a:d:c:C:RP")) != -1) {
         switch (argument) {
             case 'f': {
                 char* opened_file = optarg;
@@ -106,23 +378,34 @@ int main(int argc, char** argv) {
                 break;
             }           
             case 'h':
-                printf("\noss [-h] [-n proc] [-s simul] [-t timeToLaunchNewChild] [-f logfile]\n");
+                printf("\noss [-h] [-n proc] [-s simul] [-t timeToLaunchNewChild] [-f logfile] [-S shards] [-w workload] [-r speed] [-T tick] [-p policy] [-a aging] [-d resolution] [-c checkpoint] [-C interval] [-R] [-P]\n");
                 printf("h is the help screen\n"
                     "n is the total number of child processes oss will ever launch\n"
                     "s specifies the maximum number of concurrent running processes\n"
                     "t is for processes speed as they will trickle into the system at a speed dependent on parameter\n"
-                    "f is for a logfile as previously\n\n");
+                    "f is for a logfile as previously\n"
+                    "S is the number of shard processes that split the resource classes (default 1)\n"
+                    "w is a workload profile: uniform, zipf, hotspot, bursty, a profile file or key=value settings\n"
+                    "r paces the clock to wall time, simulated seconds per wall second\n"
+                    "T is the wall nanoseconds between loop iterations in real time mode (default 100000)\n"
+                    "p is the order blocked requests are granted in: index, wait, age or held\n"
+                    "a is how fast waiting requests gain priority, 0 turns aging off\n"
+                    "d is how deadlocks are broken: kill the victim or preempt the instances the others wait on\n"
+                    "c is a checkpoint file the manager state is saved to\n"
+                    "C is the simulated seconds between checkpoints (default 1)\n"
+                    "R resumes from the checkpoint file, n, s, t, the workload, policy and resolution come from the checkpoint\n"
+                    "P times each main loop phase and IPC call, dumped on exit and on SIGUSR1\n\n");
                 exit(0);
             case 'n':
                 processCount = atoi(optarg);
-                if (processCount > 18) {
+                if (processCount > MAX_PROCESSES) {
                     printf("invalid processCount\n");
                     exit(1);
                 }                
                 break;
             case 's':
                 simultaneousCount = atoi(optarg);
-                if (simultaneousCount > 18) {
+                if (simultaneousCount > MAX_PROCESSES) {
                     printf("invalid simultaneousCount\n");
                     exit(1);
                 }
@@ -130,73 +413,199 @@ int main(int argc, char** argv) {
             case 't':
                 processSpawnRate = atoi(optarg);
                 break;
+            case 'w':
+                loadWorkload(optarg);
+                break;
+            case 'r':
+                realTimeSpeed = atof(optarg);
+                if (realTimeSpeed <= 0) {
+                    printf("invalid speed factor\n");
+                    exit(1);
+                }
+                break;
+            case 'T':
+                realTimeTickNano = atol(optarg);
+                if (realTimeTickNano <= 0) {
+                    printf("invalid tick\n");
+                    exit(1);
+                }
+                break;
+            case 'p': {
+                grantPolicy = -1;
+                for (int i = 0; i < sizeof(policyNames) / sizeof(policyNames[0]); i++) {
+                    if (strcmp(optarg, policyNames[i]) == 0) {
+                        grantPolicy = i;
+                    }
+                }
+                if (grantPolicy == -1) {
+                    printf("invalid grant policy\n");
+                    exit(1);
+                }
+                break;
+            }
+            case 'a':
+                agingFactor = atof(optarg);
+                if (agingFactor < 0) {
+                    printf("invalid aging factor\n");
+                    exit(1);
+                }
+                break;
+            case 'd': {
+                resolution = -1;
+                for (int i = 0; i < sizeof(resolutionNames) / sizeof(resolutionNames[0]); i++) {
+                    if (strcmp(optarg, resolutionNames[i]) == 0) {
+                        resolution = i;
+                    }
+                }
+                if (resolution == -1) {
+                    printf("invalid deadlock resolution\n");
+                    exit(1);
+                }
+                break;
+            }
+            case 'c':
+                checkpointName = optarg;
+                break;
+            case 'C':
+                checkpointInterval = atof(optarg);
+                if (checkpointInterval <= 0) {
+                    printf("invalid checkpoint interval\n");
+                    exit(1);
+                }
+                break;
+            case 'R':
+                restartRun = 1;
+                break;
+            case 'P':
+                profiling = 1;
+                break;
+            case 'S':
+                shardCount = atoi(optarg);
+                if (shardCount < 1 || shardCount > MAX_SHARDS) {
+                    printf("invalid shard count\n");
+                    exit(1);
+                }
+                break;
             default:
                 printf("invalid commands\n");
                 exit(1);
         }
     }
 
-    if (processCount == 0 || processSpawnRate == 0 || simultaneousCount == 0 || filename == NULL) {
+    if (filename == NULL || (restartRun == 0 && (processCount == 0 || processSpawnRate == 0 || simultaneousCount == 0))) {
         printf("invalid commands\n");
         exit(1);
     }   
 
-    // create message queue file
-    system("touch msgq.txt"); 
-
-    // initialize process table
-    for (int i = 0; i < 18; i++)  
-    {
-        childTable[i].occupied = 0; // either true or false
-        childTable[i].pid = 0;   // process id of this child
-        childTable[i].startSeconds = 0; // time when it was created
-        childTable[i].startNano = 0;    // time when it was created
-        childTable[i].expectingResponse = 0; // do we expect message from this child
+    if (restartRun == 1 && checkpointName == NULL) {
+        printf("restarting needs a checkpoint file\n");
+        exit(1);
     }
 
-    // setup resource matrices
-    for (int i = 0; i < 10; i++) {
-        for (int j = 0; j < 18; j++)
-        {
-            allocatedMatrix[i][j] = 0;
-            requestMatrix[i][j] = 0;
-        }
+    if (agingFactor < 0) {
+        agingFactor = grantPolicy == POLICY_INDEX ? 0 : 1;
     }
 
-    // setup all resources vector
-    for (int i =0; i<10; i++) {
-        allResources[i] = 0;
+    // map the checkpoint file before anything needs cleaning up
+    if (checkpointName != NULL) {
+        openCheckpoint();
     }
 
     // make shared memory
-    shmID = shmget(SHM_KEY, sizeof(unsigned) * 2, 0777 | IPC_CREAT);
+    // private ids so any number of oss instances can run side by side,
+    // the workers get the ids on their command line
+    shmID = shmget(IPC_PRIVATE, sizeof(sharedState), PERMS | IPC_CREAT);
     if (shmID == -1) 
     {
         perror("Unable to acquire the shared memory segment.\n");
         handleTermination();
     }
+    recordOwnedIds();
     shmPtr = (unsigned*)shmat(shmID, NULL, 0);
-    if (shmPtr == NULL) 
+    if (shmPtr == (void*)-1) 
     {
+        shmPtr = NULL;
         perror("Unable to connect to the shared memory segment.\n");
         handleTermination();
     }
     memcpy(shmPtr, simClock, sizeof(unsigned) * 2);
 
-    // make message queue
-    key_t messageQueueKey = ftok("msgq.txt", 1);
-    if (messageQueueKey == -1) 
+    // point the manager tables at the shared state
+    state = (sharedState*)shmPtr;
+    childTable = state->childTable;
+    allResources = state->allResources;
+    tables = &state->index;
+    stats = &state->stats;
+    memset(stats, 0, sizeof(runStats));
+
+    // setup process shared shard locks
+    pthread_mutexattr_t lockAttr;
+    pthread_mutexattr_init(&lockAttr);
+    pthread_mutexattr_setpshared(&lockAttr, PTHREAD_PROCESS_SHARED);
+    for (int s = 0; s < shardCount; s++) {
+        pthread_mutex_init(&state->shardLocks[s], &lockAttr);
+    }
+    pthread_mutexattr_destroy(&lockAttr);
+
+    // initialize process table
+    for (int i = 0; i < MAX_PROCESSES; i++)  
     {
-        perror("Unable to generate a key for the message queue.\n");
-        handleTermination();
+        childTable[i].occupied = 0; // either true or false
+        childTable[i].pid = 0;   // process id of this child
+        childTable[i].startSeconds = 0; // time when it was created
+        childTable[i].startNano = 0;    // time when it was created
+        childTable[i].expectingResponse = 0; // do we expect message from this child
+    }
+
+    // setup all resources vector
+    for (int i =0; i<NUM_RESOURCES; i++) {
+        allResources[i] = 0;
     }
 
-    msgqId = msgget(messageQueueKey, PERMS | IPC_CREAT);
+    // setup the sparse tables, nothing is held or waited on
+    clearTables(tables);
+
+    // a restart takes the tables and counters from the checkpoint
+    if (restartRun == 1) {
+        restoreCheckpoint();
+    }
+
+    // make message queue
+    msgqId = msgget(IPC_PRIVATE, PERMS | IPC_CREAT);
     if (msgqId == -1) 
     {
         perror("Unable to create or access the message queue.\n");
         handleTermination();
     }
+    recordOwnedIds();
+
+    // make the phase timing segment
+    if (profiling == 1) {
+        profileID = shmget(IPC_PRIVATE, sizeof(profilePhase) * PHASE_COUNT, PERMS | IPC_CREAT);
+        if (profileID == -1) {
+            perror("Unable to acquire the profile memory segment.\n");
+            handleTermination();
+        }
+        recordOwnedIds();
+        profile = (profilePhase*)shmat(profileID, NULL, 0);
+        if (profile == (void*)-1) {
+            profile = NULL;
+            perror("Unable to connect to the profile memory segment.\n");
+            handleTermination();
+        }
+        memset(profile, 0, sizeof(profilePhase) * PHASE_COUNT);
+        signal(SIGUSR1, requestProfileDump);
+    }
+
+    launchShards();
+
+    if (restartRun == 1) {
+        relaunchWorkers();
+    }
+
+    if (realTimeSpeed > 0) {
+        startRealTimeClock();
+    }
 
     launchChildren();
     return 0;
@@ -205,7 +614,7 @@ int main(int argc, char** argv) {
 // Function to print the process table
 void showProcessTable() {
     // Open the file in append mode
-    FILE* file = fopen(filename, "a+");
+    FILE* file = openLogFile();
 
     if (file == NULL) {
         perror("Error opening file");
@@ -236,13 +645,24 @@ void showProcessTable() {
     fclose(file);
 }
 
+// Function to print the resource column labels above a table
+void showResourceHeader(FILE* out) {
+    fprintf(out, "%4s", "");
+    for (int i = 0; i < NUM_RESOURCES; i++) {
+        char label[16];
+        snprintf(label, sizeof(label), "R%d", i);
+        fprintf(out, " %-3s", label);
+    }
+    fprintf(out, "\n");
+}
+
 // Function to print the resource tables
 void showResourceTables() {
-    int numResources = 10;
+    int numResources = NUM_RESOURCES;
     int numProcesses = totalLaunched;
 
     // Open the file in append mode
-    FILE* file = fopen(filename, "a+");
+    FILE* file = openLogFile();
 
     if (file == NULL) {
         perror("Error opening file");
@@ -251,15 +671,14 @@ void showResourceTables() {
 
     // Print to the file
     fprintf(file, "Allocated Matrix:\n");
-    fprintf(file, "%4s %-3s %-3s %-3s %-3s %-3s %-3s %-3s %-3s %-3s %-3s\n",
-            "", "R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7", "R8", "R9");
+    showResourceHeader(file);
 
     // append allocation table data
     for (int j = 0; j < numProcesses; j++) {
         fprintf(file, "P%-3d ", j);
 
         for (int i = 0; i < numResources; i++) {
-            fprintf(file, " %-3d", allocatedMatrix[i][j]);
+            fprintf(file, " %-3d", allocationOf(tables, i, j));
         }
 
         fprintf(file, "\n");
@@ -267,15 +686,14 @@ void showResourceTables() {
 
     fprintf(file, "\n");
     fprintf(file, "Requested Matrix:\n");
-    fprintf(file, "%4s %-3s %-3s %-3s %-3s %-3s %-3s %-3s %-3s %-3s %-3s\n",
-            "", "R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7", "R8", "R9");
+    showResourceHeader(file);
 
     // append requested table data
     for (int j = 0; j < numProcesses; j++) {
         fprintf(file, "P%-3d ", j);
 
         for (int i = 0; i < numResources; i++) {
-            fprintf(file, " %-3d", requestMatrix[i][j]);
+            fprintf(file, " %-3d", tables->processes[j].waitingFor == i);
         }
 
         fprintf(file, "\n");
@@ -284,15 +702,14 @@ void showResourceTables() {
 
     // Print to the screen
     printf("Allocated Matrix:\n");
-    printf("%4s %-3s %-3s %-3s %-3s %-3s %-3s %-3s %-3s %-3s %-3s\n",
-            "", "R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7", "R8", "R9");
+    showResourceHeader(stdout);
 
     // append allocation table data
     for (int j = 0; j < numProcesses; j++) {
         printf("P%-3d ", j);
 
         for (int i = 0; i < numResources; i++) {
-            printf(" %-3d", allocatedMatrix[i][j]);
+            printf(" %-3d", allocationOf(tables, i, j));
         }
 
         printf("\n");
@@ -300,15 +717,14 @@ void showResourceTables() {
 
     printf("\n");
     printf("Requested Matrix:\n");
-    printf("%4s %-3s %-3s %-3s %-3s %-3s %-3s %-3s %-3s %-3s %-3s\n",
-            "", "R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7", "R8", "R9");
+    showResourceHeader(stdout);
 
     // append requested table data
     for (int j = 0; j < numProcesses; j++) {
         printf("P%-3d ", j);
 
         for (int i = 0; i < numResources; i++) {
-            printf(" %-3d", requestMatrix[i][j]);
+            printf(" %-3d", tables->processes[j].waitingFor == i);
         }
 
         printf("\n");
@@ -322,29 +738,38 @@ void showResourceTables() {
 // Function to launch new children, check deadlocks, and clear resources
 void launchChildren() {
     while (totalTerminated != processCount) {
+        unsigned long long loopStart = profileStart(profile);
+        if (profileDumpRequested) {
+            profileDumpRequested = 0;
+            writeProfile();
+        }
+
+        if (stopRequested) {
+            // keep where we got to so the run can be resumed
+            if (checkpoint != NULL) {
+                writeCheckpoint();
+            }
+            handleTermination();
+        }
+
         // update clock
-        launchTimePassed += 100000; 
-        incrementSimulatedClock();
-    
+        unsigned long long phaseStart = profileStart(profile);
+        launchTimePassed += incrementSimulatedClock();
+        profileEnd(profile, PHASE_CLOCK, phaseStart);
+
         // determine if we should launch a child
         if (launchTimePassed >= processSpawnRate || totalLaunched == 0) 
         {
             if (totalLaunched < processCount && totalLaunched < simultaneousCount + totalTerminated) {
                 // launch new child
-                pid_t pid = fork();
-                if (pid == 0) 
-                {
-                    char* args[] = {"./worker", NULL};
-                    execvp(args[0], args);
-                }
-                else 
-                {
-                    childTable[totalLaunched].pid = pid;
-                    childTable[totalLaunched].occupied = 1;
-                    childTable[totalLaunched].expectingResponse = 0;
-                    childTable[totalLaunched].startSeconds = simClock[0];
-                    childTable[totalLaunched].startNano = simClock[1];
-                } 
+                phaseStart = profileStart(profile);
+                pid_t pid = startWorker(totalLaunched, NULL);
+                profileEnd(profile, PHASE_LAUNCH, phaseStart);
+                childTable[totalLaunched].pid = pid;
+                childTable[totalLaunched].occupied = 1;
+                childTable[totalLaunched].expectingResponse = 0;
+                childTable[totalLaunched].startSeconds = simClock[0];
+                childTable[totalLaunched].startNano = simClock[1];
                 totalLaunched += 1;
             }
 
@@ -352,19 +777,23 @@ void launchChildren() {
         }
 
         // check if any child processes terminated
+        phaseStart = profileStart(profile);
         for (int i=0; i<totalLaunched; i++) 
         {
             int childStatus;
             pid_t childPid = childTable[i].pid;
+            unsigned long long waitStart = profileStart(profile);
             pid_t result = waitpid(childPid, &childStatus, WNOHANG);
+            profileEnd(profile, PHASE_WAITPID, waitStart);
 
             if (result > 0) {
-                FILE* file = fopen(filename, "a+");
+                FILE* file = openLogFile();
                 if (file == NULL) {
                     perror("Error opening file");
                     handleTermination();
                 }
 
+                lockAllShards();
                 fprintf(file, "\nMaster detected process P%d terminated\n", i);
                 printf("\nMaster detected process P%d terminated\n", i);
                 
@@ -373,35 +802,29 @@ void launchChildren() {
                 fprintf(file, "Releasing resources: ");
                 printf("Releasing resources: ");
 
-                for (int c=0; c<10; c++) {
-                    if (allocatedMatrix[c][i] != 0)
-                    {
-                        allResources[c] -= allocatedMatrix[c][i];
-                        fprintf(file, "R%d: %d ", c, allocatedMatrix[c][i]);
-                        printf("R%d: %d ", c, allocatedMatrix[c][i]);
-                    }
-
-                    requestMatrix[c][i] = 0;
-                    allocatedMatrix[c][i] = 0;
-                }
+                recordProcessEnd(i, 0);
+                releaseProcessResources(i, file, "R%d: %d ");
 
                 fprintf(file, "\n");
                 printf("\n");
 
                 childTable[i].occupied = 0;
                 childTable[i].expectingResponse = 0;
+                forgetWorker(i);
                 totalTerminated += 1;
+                unlockAllShards();
                 fclose(file);
             }
         }
+        profileEnd(profile, PHASE_REAP, phaseStart);
 
         // check if we should stop
         if (processCount == totalTerminated) {
             handleTermination();
         }
 
-        // check and send messages to the children
-        checkChildMessage();
+        // send the first go-ahead to new children, the shards serve the resource messages
+        phaseStart = profileStart(profile);
         for (int i=0; i<totalLaunched; i++) 
         {
             if (childTable[i].occupied == 1) {
@@ -411,20 +834,34 @@ void launchChildren() {
                 }
             }
         }
+        profileEnd(profile, PHASE_DISPATCH, phaseStart);
 
         // run deadlock detection algorithm
         if (simClock[0] >= oneSecondPassed + 1) {
+            phaseStart = profileStart(profile);
             runDetectionAlgorithm();
+            profileEnd(profile, PHASE_DETECT, phaseStart);
+        }
+
+        // save the manager state
+        if (checkpoint != NULL && simulatedNano() >= nextCheckpointNano) {
+            phaseStart = profileStart(profile);
+            writeCheckpoint();
+            profileEnd(profile, PHASE_CHECKPOINT, phaseStart);
         }
 
         // show all the resource and process information
         if (simClock[1] >= quarterSecondPassed + quarterSecond 
         || (simClock[1] == 0 && simClock[0] > 1)) 
         {
+            phaseStart = profileStart(profile);
             showProcessTable();
             showResourceTables();
             quarterSecondPassed = simClock[1];
+            profileEnd(profile, PHASE_DISPLAY, phaseStart);
         }
+
+        profileEnd(profile, PHASE_LOOP, loopStart);
     }
 
     handleTermination();
@@ -436,125 +873,116 @@ void runDetectionAlgorithm() {
     oneSecondPassed = simClock[0];
 
     // Open the file in append mode
-    FILE* file = fopen(filename, "a+");
+    FILE* file = openLogFile();
     if (file == NULL) {
         perror("Error opening file");
         handleTermination();;
     }
 
-    // print values in allResource vector
-    int numResources = 10;   
+    // hold every shard so the merged tables are consistent
+    lockAllShards();
+
     int numProcesses = totalLaunched;
 
+    stats->detectionRuns += 1;
+
     // Master running deadlock detection
     fprintf(file, "Master running deadlock detection at time %u:%u\n", simClock[0], simClock[1]);
     printf("Master running deadlock detection at time %u:%u\n",simClock[0], simClock[1]);
 
     // check for available resources
-    // give child resource is available
-    for (int i = 0; i < numProcesses; i++) {
-        for (int j = 0; j < numResources; j++) {
-            if (requestMatrix[j][i] == 1 && allResources[j] != 20) 
-            {
-    
-                allResources[j] += 1;
-                requestMatrix[j][i] = 0;
-                allocatedMatrix[j][i] += 1;
-                childTable[i].expectingResponse = 0;
-
-                fprintf(file, "Master detected resource R%d is available, now granting it to process P%d\n    Master removing process P%d from wait queue at time %u:%u\n", 
-                    j, i, i, simClock[0], simClock[1]);
-
-                printf("Master detected resource R%d is available, now granting it to process P%d\n    Master removing process P%d from wait queue at time %u:%u\n", 
-                    j, i, i, simClock[0], simClock[1]);
-
-                // send resource message back to child that was waiting
-                buffer.mtype = childTable[i].pid;
-                if (msgsnd(msgqId, &buffer, sizeof(messages) - sizeof(long), 0) == -1) {
-                    perror("msgsnd to child failed\n");
-                    handleTermination();
-                }      
-
-                break;
-            }
+    // give child resource is available, in grant policy order
+    int grantable[NUM_RESOURCES];
+    int grantableCount = grantableResources(allResources, tables, grantable);
+    for (int g = 0; g < grantableCount; g++) {
+        int j = grantable[g];
+        while (tables->waiterCount[j] > 0 && allResources[j] != RESOURCE_INSTANCES) {
+            int i = tables->waiterRoot[j];
+            recordGrant(i, j, simulatedNano() - stats->processes[i].requestTime);
+            allResources[j] += 1;
+            removeWaiter(i);
+            changeAllocation(j, i, 1);
+
+            fprintf(file, "Master detected resource R%d is available, now granting it to process P%d\n    Master removing process P%d from wait queue at time %u:%u\n", 
+                j, i, i, simClock[0], simClock[1]);
+
+            printf("Master detected resource R%d is available, now granting it to process P%d\n    Master removing process P%d from wait queue at time %u:%u\n", 
+                j, i, i, simClock[0], simClock[1]);
+
+            // send resource message back to child that was waiting
+            buffer.mtype = childTable[i].pid;
+            sendMessage(&buffer);
         }
     }
 
     // get child with least amount of time in the system (most recent child)
-    int deadlockedCount = 0;
+    // the same rule for every shard count: reduce the wait-for graph and only count
+    // processes no holder of their resource can ever unblock
     int leastActiveChild = 0;
-    for (int i = 0; i < numProcesses; i++) 
-    {
-        for (int j = 0; j < numResources; j++) 
-        {
-            if (requestMatrix[j][i] == 1) 
-            {
-                // update the last child
-                // this child is potentially deadlocked
-                leastActiveChild = i;
-                deadlockedCount += 1;
-            }
+    int deadlocked[MAX_PROCESSES] = {0};
+    int deadlockedCount = detectDeadlock(tables, numProcesses, deadlocked);
+    for (int i = 0; i < numProcesses; i++) {
+        if (deadlocked[i] == 1) {
+            leastActiveChild = i;
         }
     }
 
     // remove deadlock
-    // we consider a deadlock if there are more than 1 processes waiting for a resource
-    if (deadlockedCount > 1)
+    if (deadlockedCount > 0)
     {
+        stats->deadlocksFound += 1;
         printf("Processes ");
         fprintf(file, "Processes ");
         for (int i=0; i<totalLaunched; i++) 
         {
-            for (int j=0; j<10; j++)
+            if (deadlocked[i] == 1)
             {
-                if (requestMatrix[j][i] == 1)
-                {
-                    fprintf(file, "P%d ", i);
-                    printf("P%d ", i);
-                }
-            }
-        }
-        printf("are deadlocked.\nMaster terminating P%d to remove deadlock\n", leastActiveChild);
-        fprintf(file, "are deadlocked.\nMaster terminating P%d to remove deadlock\n", leastActiveChild);
-        
-        // terminate deadlocked child
-        if (kill(childTable[leastActiveChild].pid, SIGKILL) == -1) {
-            perror("kill error in parent\n");
-            handleTermination();
-        }
-        else {
-            int childStatus;
-            if (waitpid(childTable[leastActiveChild].pid, &childStatus, 0) == -1) {
-                perror("waitpid error in parent\n");
-                handleTermination();
+                fprintf(file, "P%d ", i);
+                printf("P%d ", i);
             }
         }
+        printf("are deadlocked.\n");
+        fprintf(file, "are deadlocked.\n");
 
-        // clear removed child's resources
-        fprintf(file, "Master terminated Process P%d \nReleasing process P%d resources: "
-            , leastActiveChild, leastActiveChild);
-        printf("Master terminated Process P%d \nReleasing process P%d resources: "
-            , leastActiveChild, leastActiveChild);
-
-        for (int c=0; c<10; c++) 
+        // in preempt mode only take back what the other deadlocked processes wait on,
+        // the victim is killed when it holds nothing they need
+        int preempted = resolution == RESOLVE_PREEMPT ? preemptDeadlock(deadlocked, file) : -1;
+        if (preempted == -1)
         {
-            if (allocatedMatrix[c][leastActiveChild] > 0)
-            {
-                fprintf(file, "R%d:%d ", c, allocatedMatrix[c][leastActiveChild]);
-                printf("R%d:%d ", c, allocatedMatrix[c][leastActiveChild]);
-                allResources[c] -= allocatedMatrix[c][leastActiveChild];
+            stats->victims += 1;
+            printf("Master terminating P%d to remove deadlock\n", leastActiveChild);
+            fprintf(file, "Master terminating P%d to remove deadlock\n", leastActiveChild);
+
+            // terminate deadlocked child
+            if (kill(childTable[leastActiveChild].pid, SIGKILL) == -1) {
+                perror("kill error in parent\n");
+                handleTermination();
+            }
+            else {
+                int childStatus;
+                if (waitpid(childTable[leastActiveChild].pid, &childStatus, 0) == -1) {
+                    perror("waitpid error in parent\n");
+                    handleTermination();
+                }
             }
 
-            requestMatrix[c][leastActiveChild] = 0;
-            allocatedMatrix[c][leastActiveChild] = 0;
-        }
+            // clear removed child's resources
+            fprintf(file, "Master terminated Process P%d \nReleasing process P%d resources: "
+                , leastActiveChild, leastActiveChild);
+            printf("Master terminated Process P%d \nReleasing process P%d resources: "
+                , leastActiveChild, leastActiveChild);
+
+            recordProcessEnd(leastActiveChild, 1);
+            releaseProcessResources(leastActiveChild, file, "R%d:%d ");
 
-        fprintf(file, "\n\n");
-        printf("\n\n");
+            fprintf(file, "\n\n");
+            printf("\n\n");
 
-        childTable[leastActiveChild].occupied = 0;
-        childTable[leastActiveChild].expectingResponse = 0;
-        totalTerminated += 1;
+            childTable[leastActiveChild].occupied = 0;
+            childTable[leastActiveChild].expectingResponse = 0;
+            forgetWorker(leastActiveChild);
+            totalTerminated += 1;
+        }
     }
     else
     {
@@ -565,135 +993,233 @@ void runDetectionAlgorithm() {
 
     // Close file
     fclose(file);            
+    unlockAllShards();
 
     // Run detection again to check if deadlock is gone
-    if (deadlockedCount > 1) {
+    if (deadlockedCount > 0) {
         runDetectionAlgorithm();
     }
 
 }
 
+// Function to fork and exec the worker for a process table slot
+// heldArg lists the instances it starts with, R0:R1:etc, for workers relaunched from a checkpoint
+pid_t startWorker(int slot, const char* heldArg) {
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("Unable to fork a worker process.\n");
+        handleTermination();
+    }
+    else if (pid == 0) 
+    {
+        char* args[14] = {workerPath};
+        int argCount = 1;
+
+        // tell the worker our private queue and shared memory ids
+        char queueArg[12];
+        char memoryArg[12];
+        sprintf(queueArg, "%d", msgqId);
+        sprintf(memoryArg, "%d", shmID);
+        args[argCount++] = "-q";
+        args[argCount++] = queueArg;
+        args[argCount++] = "-m";
+        args[argCount++] = memoryArg;
+
+        // tell the worker the request queue of the shard that owns each resource class
+        char shardArg[MAX_SHARDS * 12] = "";
+        for (int s = 0; s < shardCount; s++) {
+            char shardQueue[12];
+            sprintf(shardQueue, s == 0 ? "%d" : ",%d", shardQueues[s]);
+            strcat(shardArg, shardQueue);
+        }
+        args[argCount++] = "-S";
+        args[argCount++] = shardArg;
+
+        // pass the workload model along
+        char workloadArg[sizeof(workloadSpec) + 32];
+        strcpy(workloadArg, workloadSpec);
+        if (workloadSeed != 0) {
+            sprintf(workloadArg + strlen(workloadArg), "%sseed=%llu",
+                workloadArg[0] == '\0' ? "" : ",", workloadSeed + slot);
+        }
+        if (workloadArg[0] != '\0') {
+            args[argCount++] = "-w";
+            args[argCount++] = workloadArg;
+        }
+
+        if (heldArg != NULL) {
+            args[argCount++] = "-H";
+            args[argCount++] = (char*)heldArg;
+        }
+
+        char profileArg[12];
+        if (profile != NULL) {
+            sprintf(profileArg, "%d", profileID);
+            args[argCount++] = "-P";
+            args[argCount++] = profileArg;
+        }
+
+        args[argCount] = NULL;
+        execvp(args[0], args);
+
+        // never return into a copy of the manager loop
+        perror("Unable to exec the worker.\n");
+        _exit(1);
+    }
+
+    if (checkpoint != NULL) {
+        checkpoint->owner.workerPids[slot] = pid;
+        checkpoint->owner.workerStarts[slot] = processStart(pid);
+    }
+    return pid;
+}
+
 // Function to send a message to a child
 void sendChildMessage(int targetChild) {
     // Send a message to the child
     // update expecting response flag for the child
+    // the flag is set first because a shard may answer the child right away
     buffer.mtype = childTable[targetChild].pid;
-    if (msgsnd(msgqId, &buffer, sizeof(messages) - sizeof(long), 0) == -1) {
-        perror("msgsnd to child failed\n");
-        handleTermination();
-    }
     childTable[targetChild].expectingResponse = 1;
+    sendMessage(&buffer);
 }
 
 // Function to check a message from children
 void checkChildMessage() {        
     // get child message
+    // the shard blocks on its own request queue, a signal handled while blocked is not an error
     messages childMsg;
-    if (msgrcv(msgqId, &childMsg, sizeof(messages), getpid(), IPC_NOWAIT) == -1) {
-        if (errno == ENOMSG) {
-            // No message available
-        } 
-        else {
-            perror("Error receiving message in child process");
-            handleTermination(); 
-        }
+    int received;
+    do {
+        received = msgrcv(shardQueues[shardIndex], &childMsg, sizeof(messages), 0, 0);
+    } while (received == -1 && errno == EINTR);
+    if (received == -1) {
+        perror("Error receiving message in child process");
+        handleTermination(); 
     } 
     else
     {
         // which child sent us a message
         // get the child who sent message
+        unsigned long long handleStart = profileStart(profile);
         int targetChild = -1;
         pid_t senderPID = childMsg.targetChild;
 
+        // shards keep their own copy of the clock up to date
+        memcpy(simClock, state->clock, sizeof(unsigned int) * 2);
+
+        // the log lines are built under the lock and written once it is dropped
+        char logLines[512] = "";
+        int sendMessageBack = 0;
+        int shard = childMsg.resourceType % shardCount;
+        lockShard(shard);
         for (int i=0; i<processCount; i++)  
         {
             if (childTable[i].pid == senderPID) {
                 targetChild = i;
             }
         }
+
+        // drop messages from a child that was already removed
+        if (targetChild == -1 || childTable[targetChild].occupied == 0) {
+            unlockShard(shard);
+            profileEnd(profile, PHASE_HANDLE, handleStart);
+            return;
+        }
         
         // check child message content
-        int sendMessageBack = 0;
         if (childMsg.requestOrRelease == 1) 
         {         
-            FILE* file = fopen(filename, "a+");
-            if (file == NULL) {
-                perror("Error opening file");
-                handleTermination();
-            }   
-
-            fprintf(file, "Master has acknowledged Process P%d releasing R%d at time %u:%u\n\n",
-                targetChild, childMsg.resourceType, simClock[0], simClock[1]);
-            
-            printf("Master has acknowledged Process P%d releasing R%d at time %u:%u\n\n",
+            snprintf(logLines, sizeof(logLines), "Master has acknowledged Process P%d releasing R%d at time %u:%u\n\n",
                 targetChild, childMsg.resourceType, simClock[0], simClock[1]);
 
             // child is releasing a resource
+            recordRelease(targetChild, childMsg.resourceType, 1);
             allResources[childMsg.resourceType] -= 1;
-            allocatedMatrix[childMsg.resourceType][targetChild] -= 1;
+            changeAllocation(childMsg.resourceType, targetChild, -1);
             sendMessageBack = 1;
-
-            fclose(file);
         }
         else 
         {
-            FILE* file = fopen(filename, "a+");
-            if (file == NULL) {
-                perror("Error opening file");
-                handleTermination();
-            }
-
-            fprintf(file, "\nMaster has detected Process P%d requesting R%d at time %u:%u\n",
-                targetChild, childMsg.resourceType, simClock[0], simClock[1]);
-
-            printf("\nMaster has detected Process P%d requesting R%d at time %u:%u\n",
+            int length = snprintf(logLines, sizeof(logLines), "\nMaster has detected Process P%d requesting R%d at time %u:%u\n",
                 targetChild, childMsg.resourceType, simClock[0], simClock[1]);
             
             // child is requesting a resource
-            if (allResources[childMsg.resourceType] != 20) 
+            stats->processes[targetChild].requests += 1;
+            stats->resources[childMsg.resourceType].requests += 1;
+            if (allResources[childMsg.resourceType] != RESOURCE_INSTANCES) 
             {
-                fprintf(file, "Master granting P%d request R%d at time %u:%u\n", 
-                    targetChild, childMsg.resourceType, simClock[0], simClock[1]);
-
-                printf("Master granting P%d request R%d at time %u:%u\n", 
+                recordGrant(targetChild, childMsg.resourceType, 0);
+                snprintf(logLines + length, sizeof(logLines) - length, "Master granting P%d request R%d at time %u:%u\n", 
                     targetChild, childMsg.resourceType, simClock[0], simClock[1]);
 
                 allResources[childMsg.resourceType] += 1;
-                allocatedMatrix[childMsg.resourceType][targetChild] += 1;                
+                changeAllocation(childMsg.resourceType, targetChild, 1);
                 sendMessageBack = 1;
             }
             else 
             {
                 // cant give child resource so put them in wait queue
-                printf("Master: no instances of R%d available, P%d added to wait queue at time %u:%u\n\n",
-                    childMsg.resourceType, targetChild, simClock[0], simClock[1]);
-
-                fprintf(file, "Master: no instances of R%d available, P%d added to wait queue at time %u:%u\n\n",
+                snprintf(logLines + length, sizeof(logLines) - length,
+                    "Master: no instances of R%d available, P%d added to wait queue at time %u:%u\n\n",
                     childMsg.resourceType, targetChild, simClock[0], simClock[1]);
 
-                requestMatrix[childMsg.resourceType][targetChild] = 1;
+                addWaiter(childMsg.resourceType, targetChild);
+                stats->processes[targetChild].requestTime = simulatedNano();
+                stats->resources[childMsg.resourceType].blocked += 1;
             }
-
-            fclose(file);
         }
 
+        pid_t replyTo = childTable[targetChild].pid;
+        unlockShard(shard);
+
         // send confirmation message back
         if (sendMessageBack == 1)
         {
-            buffer.mtype = childTable[targetChild].pid;
-            childTable[targetChild].expectingResponse = 0;
+            buffer.mtype = replyTo;
+            sendMessage(&buffer);
+        }
 
-            if (msgsnd(msgqId, &buffer, sizeof(messages) - sizeof(long), 0) == -1) {
-                perror("msgsnd to child failed\n");
-                handleTermination();
-            }
+        FILE* file = openLogFile();
+        if (file == NULL) {
+            perror("Error opening file");
+            handleTermination();
         }
+        fputs(logLines, file);
+        fclose(file);
+        printf("%s", logLines);
+        profileEnd(profile, PHASE_HANDLE, handleStart);
     }
 }
 
 // Function to update the click by 0.1 milliseconds
-void incrementSimulatedClock() {
-    int nanoseconds = 100000;
+// or to the paced wall time in real time mode, returns the nanoseconds added
+unsigned long long incrementSimulatedClock() {
+    unsigned long long nanoseconds = 100000;
+
+    if (realTimeSpeed > 0) 
+    {
+        // sleep until the next tick then catch up with the wall clock
+        waitForTick();
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double wallNano = (now.tv_sec - realTimeStart.tv_sec) * 1e9 + (now.tv_nsec - realTimeStart.tv_nsec);
+        unsigned long long target = realTimeBase + (unsigned long long)(wallNano * realTimeSpeed);
+        unsigned long long current = simulatedNano();
+
+        // the clock never goes backwards
+        nanoseconds = 0;
+        if (target > current) {
+            nanoseconds = target - current;
+            simClock[0] = target / 1000000000ULL;
+            simClock[1] = target % 1000000000ULL;
+        }
+
+        memcpy(shmPtr, simClock, sizeof(unsigned int) * 2);
+        return nanoseconds;
+    }
+
     simClock[1] += nanoseconds;
 
     if (simClock[1] >= 1000000000) 
@@ -706,15 +1232,1069 @@ void incrementSimulatedClock() {
     }
 
     memcpy(shmPtr, simClock, sizeof(unsigned int) * 2);
+    return nanoseconds;
+}
+
+// Function to start the wall clock and the timerfd the main loop sleeps on
+void startRealTimeClock() {
+    tickFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (tickFd == -1) {
+        perror("Unable to create the tick timer.\n");
+        handleTermination();
+    }
+
+    struct itimerspec tick;
+    tick.it_interval.tv_sec = realTimeTickNano / 1000000000L;
+    tick.it_interval.tv_nsec = realTimeTickNano % 1000000000L;
+    tick.it_value = tick.it_interval;
+    if (timerfd_settime(tickFd, 0, &tick, NULL) == -1) {
+        perror("Unable to start the tick timer.\n");
+        handleTermination();
+    }
+
+    // a resumed run carries on from the checkpoint time
+    realTimeBase = simulatedNano();
+    clock_gettime(CLOCK_MONOTONIC, &realTimeStart);
+}
+
+// Function to sleep until the next timer tick
+// missed ticks are not replayed since the clock follows the wall time
+void waitForTick() {
+    uint64_t expirations;
+    if (read(tickFd, &expirations, sizeof(expirations)) == -1 && errno != EINTR) {
+        perror("Unable to read the tick timer.\n");
+        handleTermination();
+    }
+}
+
+// Function to launch the shard processes that serve resource messages
+// every shard reads requests from its own queue so they do not contend on one
+void launchShards() {
+    for (int s = 0; s < shardCount; s++) {
+        shardQueues[s] = msgget(IPC_PRIVATE, PERMS | IPC_CREAT);
+        if (shardQueues[s] == -1) {
+            perror("Unable to create a shard message queue.\n");
+            handleTermination();
+        }
+        shardQueueCount += 1;
+        recordOwnedIds();
+    }
+
+    // anything still buffered would be printed again by every shard when it exits
+    fflush(stdout);
+    for (int s = 0; s < shardCount; s++) 
+    {
+        pid_t pid = fork();
+        if (pid == -1) {
+            perror("Unable to fork a shard process.\n");
+            handleTermination();
+        }
+        else if (pid == 0) 
+        {
+            shardIndex = s;
+            runShard();
+        }
+        shardPids[s] = pid;
+        recordOwnedIds();
+    }
+}
+
+// Function to serve request and release messages for this shard's resources
+void runShard() {
+    // Ctrl-C reaches the whole process group, a shard killed by it could die holding its
+    // lock, so only the coordinator reacts and stops the shards with SIGTERM once it is done
+    // with the locks, it dumps the profile too
+    signal(SIGINT, SIG_IGN);
+    signal(SIGUSR1, SIG_IGN);
+
+    // a shard shares the checkpoint lock with the coordinator through the descriptor and
+    // the mapping, dropping both lets the lock go with the coordinator if it is killed
+    if (checkpoint != NULL) {
+        munmap(checkpoint, sizeof(checkpointFile));
+        checkpoint = NULL;
+        close(checkpointFd);
+        checkpointFd = -1;
+    }
+    while (1) {
+        checkChildMessage();
+    }
+}
+
+// Function to lock the resource rows owned by a shard
+void lockShard(int shard) {
+    unsigned long long lockStart = profileStart(profile);
+    pthread_mutex_lock(&state->shardLocks[shard]);
+    profileEnd(profile, PHASE_LOCK, lockStart);
+}
+
+// Function to unlock the resource rows owned by a shard
+void unlockShard(int shard) {
+    pthread_mutex_unlock(&state->shardLocks[shard]);
+}
+
+// Function to lock every shard, always in the same order
+void lockAllShards() {
+    for (int s = 0; s < shardCount; s++) {
+        lockShard(s);
+    }
+}
+
+// Function to unlock every shard
+void unlockAllShards() {
+    for (int s = shardCount - 1; s >= 0; s--) {
+        unlockShard(s);
+    }
+}
+
+// Function to select a built in workload profile, read a profile file or take inline settings
+// profile files hold one key=value per line, # starts a comment
+// -w can be given more than once, later settings are added after earlier ones
+void loadWorkload(const char* profile) {
+    // inline key=value,key=value settings
+    if (strchr(profile, '=') != NULL) {
+        char settings[sizeof(workloadSpec)];
+        strncpy(settings, profile, sizeof(settings) - 1);
+        settings[sizeof(settings) - 1] = '\0';
+        for (char* setting = strtok(settings, ","); setting != NULL; setting = strtok(NULL, ",")) {
+            addWorkloadSetting(setting);
+        }
+        return;
+    }
+
+    for (int i = 0; i < sizeof(workloadProfiles) / sizeof(workloadProfiles[0]); i++) {
+        if (strcmp(profile, workloadProfiles[i][0]) == 0) {
+            char settings[sizeof(workloadSpec)];
+            strcpy(settings, workloadProfiles[i][1]);
+            for (char* setting = strtok(settings, ","); setting != NULL; setting = strtok(NULL, ",")) {
+                addWorkloadSetting(setting);
+            }
+            return;
+        }
+    }
+
+    FILE* file = fopen(profile, "r");
+    if (file == NULL) {
+        printf("workload profile doesn't exist.\n");
+        exit(1);
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        // strip comments and whitespace
+        char* comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+
+        char setting[256];
+        int length = 0;
+        for (char* c = line; *c != '\0'; c++) {
+            if (!isspace((unsigned char)*c)) {
+                setting[length++] = *c;
+            }
+        }
+        setting[length] = '\0';
+
+        if (length > 0) {
+            addWorkloadSetting(setting);
+        }
+    }
+
+    fclose(file);
+}
+
+// Function to check one key=value workload setting and add it to the spec
+void addWorkloadSetting(char* setting) {
+    char* value = strchr(setting, '=');
+    if (value == NULL) {
+        printf("invalid workload setting %s\n", setting);
+        exit(1);
+    }
+
+    int known = 0;
+    for (int i = 0; i < sizeof(workloadKeys) / sizeof(workloadKeys[0]); i++) {
+        if (strncmp(setting, workloadKeys[i], value - setting) == 0 && strlen(workloadKeys[i]) == value - setting) {
+            known = 1;
+        }
+    }
+    if (known == 0) {
+        printf("invalid workload setting %s\n", setting);
+        exit(1);
+    }
+
+    // the workers trust their values, a negative weight reaches oss as resource -1
+    char key[32];
+    snprintf(key, sizeof(key), "%.*s", (int)(value - setting), setting);
+    if (validWorkloadValue(key, value + 1) == 0) {
+        printf("invalid workload value %s\n", setting);
+        exit(1);
+    }
+
+    // the seed is handed out per worker when launching
+    if (strncmp(setting, "seed=", 5) == 0) {
+        workloadSeed = strtoull(value + 1, NULL, 10);
+        return;
+    }
+
+    if (strlen(workloadSpec) + strlen(setting) + 2 > sizeof(workloadSpec)) {
+        printf("workload profile is too long\n");
+        exit(1);
+    }
+    if (workloadSpec[0] != '\0') {
+        strcat(workloadSpec, ",");
+    }
+    strcat(workloadSpec, setting);
+}
+
+// Function to check a workload value is one the workers can use
+// returns 0 for names they do not know, negative weights and percentages outside 0-100
+int validWorkloadValue(const char* key, const char* value) {
+    char* end;
+    if (strcmp(key, "popularity") == 0) {
+        return strcmp(value, "uniform") == 0 || strcmp(value, "zipf") == 0 || strcmp(value, "hotspot") == 0;
+    }
+    if (strcmp(key, "arrival") == 0) {
+        return strcmp(value, "fixed") == 0 || strcmp(value, "exponential") == 0 || strcmp(value, "bursty") == 0;
+    }
+    if (strcmp(key, "class_mix") == 0) {
+        // weights for R0, R1, etc separated by ':'
+        const char* weight = value;
+        for (int count = 1; count <= NUM_RESOURCES; count++) {
+            double amount = strtod(weight, &end);
+            if (end == weight || amount < 0) {
+                return 0;
+            }
+            if (*end == '\0') {
+                return 1;
+            }
+            if (*end != ':') {
+                return 0;
+            }
+            weight = end + 1;
+        }
+        return 0;
+    }
+    if (strcmp(key, "zipf_s") == 0) {
+        double skew = strtod(value, &end);
+        return end != value && *end == '\0' && skew >= 0;
+    }
+
+    // everything else is a whole number
+    if (!isdigit((unsigned char)value[0])) {
+        return 0;
+    }
+    unsigned long long number = strtoull(value, &end, 10);
+    if (*end != '\0') {
+        return 0;
+    }
+    if (strcmp(key, "hot_pct") == 0 || strcmp(key, "release_pct") == 0 || strcmp(key, "term_pct") == 0) {
+        return number <= 100;
+    }
+    if (strcmp(key, "hot_classes") == 0) {
+        return number >= 1 && number <= NUM_RESOURCES;
+    }
+    return 1;
+}
+
+// Function to change how many instances of a resource a process holds
+void changeAllocation(int resource, int process, int amount) {
+    changeHolding(tables, resource, process, amount);
+}
+
+// Function to put a process in a resource's wait queue
+void addWaiter(int resource, int process) {
+    pushWaiter(tables, resource, process, grantPriority(process) + agingFactor * simulatedNano());
+}
+
+// Function to take a process out of the wait queue it is in, if any
+void removeWaiter(int process) {
+    if (tables->processes[process].waitingFor != -1) {
+        pullWaiter(tables, process);
+    }
+}
+
+// Function to get the policy part of a waiting process's key, lower goes first
+double grantPriority(int process) {
+    if (grantPolicy == POLICY_WAIT) {
+        // the request time itself, so the order does not depend on the aging factor
+        return simulatedNano();
+    }
+    else if (grantPolicy == POLICY_AGE) {
+        return (double)childTable[process].startSeconds * 1e9 + childTable[process].startNano;
+    }
+    else if (grantPolicy == POLICY_HELD) {
+        int heldInstances = 0;
+        for (int h = tables->processes[process].firstHeld; h != -1; h = tables->holdings[h].nextHeld) {
+            heldInstances += tables->holdings[h].amount;
+        }
+        return heldWeight * heldInstances;
+    }
+    return indexWeight * process;
+}
+
+// Function to give back everything a process holds and drop its waiting request
+// each released resource is logged with format, which takes the resource and amount
+void releaseProcessResources(int process, FILE* file, const char* format) {
+    // settle each held resource's utilization before the kernel frees the holdings
+    for (int h = tables->processes[process].firstHeld; h != -1; h = tables->holdings[h].nextHeld) {
+        noteResourceUse(tables->holdings[h].resource);
+    }
+
+    int classes[NUM_RESOURCES];
+    int released[NUM_RESOURCES];
+    int count = releaseColumn(allResources, tables, process, classes, released);
+    for (int k = 0; k < count; k++) {
+        int c = classes[k];
+        fprintf(file, format, c, released[c]);
+        printf(format, c, released[c]);
+        recordRelease(process, c, released[c]);
+    }
+
+    removeWaiter(process);
+}
+
+// Function to break a deadlock by taking back instances from one deadlocked process
+// only the instances the other deadlocked processes wait on are revoked, the victim keeps
+// the rest and stays in its wait queue, returns the victim or -1 when no process holds what is needed
+int preemptDeadlock(int* deadlocked, FILE* file) {
+    // how many deadlocked processes wait on each resource
+    int wanted[NUM_RESOURCES] = {0};
+    for (int p = 0; p < totalLaunched; p++) {
+        if (deadlocked[p] == 1) {
+            wanted[tables->processes[p].waitingFor] += 1;
+        }
+    }
+
+    // the most recent deadlocked process that holds something another one waits on
+    int victim = -1;
+    for (int p = totalLaunched - 1; p >= 0 && victim == -1; p--) {
+        if (deadlocked[p] == 0) {
+            continue;
+        }
+
+        for (int h = tables->processes[p].firstHeld; h != -1; h = tables->holdings[h].nextHeld) {
+            int c = tables->holdings[h].resource;
+            if (wanted[c] - (tables->processes[p].waitingFor == c) > 0) {
+                victim = p;
+                break;
+            }
+        }
+    }
+
+    if (victim == -1) {
+        return -1;
+    }
+
+    fprintf(file, "Master preempting P%d to remove deadlock\nRevoking process P%d resources: ", victim, victim);
+    printf("Master preempting P%d to remove deadlock\nRevoking process P%d resources: ", victim, victim);
+
+    // the next holding is read first since taking back everything frees this one
+    int next;
+    for (int h = tables->processes[victim].firstHeld; h != -1; h = next) {
+        next = tables->holdings[h].nextHeld;
+        int c = tables->holdings[h].resource;
+        int amount = wanted[c] - (tables->processes[victim].waitingFor == c);
+        if (amount > tables->holdings[h].amount) {
+            amount = tables->holdings[h].amount;
+        }
+        if (amount <= 0) {
+            continue;
+        }
+
+        fprintf(file, "R%d:%d ", c, amount);
+        printf("R%d:%d ", c, amount);
+        recordRevoke(victim, c, amount);
+        allResources[c] -= amount;
+        changeAllocation(c, victim, -amount);
+        for (int k = 0; k < amount; k++) {
+            sendRevokeMessage(victim, c);
+        }
+    }
+
+    fprintf(file, "\n\n");
+    printf("\n\n");
+
+    stats->preemptions += 1;
+    return victim;
+}
+
+// Function to tell a worker one instance of a resource was taken back
+// the worker is blocked waiting for its grant and reads this first
+void sendRevokeMessage(int process, int resource) {
+    messages revoke;
+    revoke.mtype = childTable[process].pid;
+    revoke.requestOrRelease = REVOKE_MESSAGE;
+    revoke.resourceType = resource;
+    revoke.targetChild = childTable[process].pid;
+    sendMessage(&revoke);
+}
+
+// Function to ask the main loop to shut down
+void requestStop(int sig) {
+    stopRequested = 1;
+}
+
+// Function to ask the main loop to dump the phase timings
+void requestProfileDump(int sig) {
+    profileDumpRequested = 1;
+}
+
+// Function to get the simulated clock in nanoseconds
+unsigned long long simulatedNano() {
+    return (unsigned long long)simClock[0] * 1000000000ULL + simClock[1];
+}
+
+// Function to get the histogram bucket of a latency
+int latencyBucket(unsigned long long nano) {
+    int bucket = nano == 0 ? 0 : 64 - __builtin_clzll(nano);
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+// Function to add the time since the last change to a resource's usage
+// called before allResources changes, with the resource's shard held
+void noteResourceUse(int resource) {
+    resourceStats* rs = &stats->resources[resource];
+    unsigned long long now = simulatedNano();
+    if (now > rs->lastChange) {
+        rs->busyArea += (unsigned long long)allResources[resource] * (now - rs->lastChange);
+        rs->lastChange = now;
+    }
+}
+
+// Function to count a grant and how long the process waited for it
+void recordGrant(int process, int resource, unsigned long long waited) {
+    processStats* ps = &stats->processes[process];
+    resourceStats* rs = &stats->resources[resource];
+
+    noteResourceUse(resource);
+    if (allResources[resource] + 1 > rs->peakInUse) {
+        rs->peakInUse = allResources[resource] + 1;
+    }
+    rs->grants += 1;
+
+    ps->grants += 1;
+    ps->held += 1;
+    if (ps->held > ps->peakHeld) {
+        ps->peakHeld = ps->held;
+    }
+    if (waited > 0) {
+        ps->blockedGrants += 1;
+        ps->blockedNano += waited;
+    }
+
+    // several shards can grant at once so the shared totals are atomic
+    __atomic_fetch_add(&stats->grantLatency[latencyBucket(waited)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->totalGrantLatency, waited, __ATOMIC_RELAXED);
+    unsigned long long longest = __atomic_load_n(&stats->maxGrantLatency, __ATOMIC_RELAXED);
+    while (waited > longest && !__atomic_compare_exchange_n(&stats->maxGrantLatency, &longest, waited, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    if (waited > 0) {
+        __atomic_fetch_add(&stats->waitLatency[latencyBucket(waited)], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats->waitedGrants, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats->totalWaitLatency, waited, __ATOMIC_RELAXED);
+    }
+}
+
+// Function to get a percentile from a latency histogram, as the upper bound of its bucket
+unsigned long long latencyPercentile(unsigned long long* histogram, double fraction) {
+    unsigned long long count = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        count += histogram[b];
+    }
+
+    unsigned long long seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS && count > 0; b++) {
+        seen += histogram[b];
+        if (seen >= fraction * count) {
+            return b == 0 ? 0 : (1ULL << b) - 1;
+        }
+    }
+    return 0;
+}
+
+// Function to count instances given back by a process
+void recordRelease(int process, int resource, int amount) {
+    noteResourceUse(resource);
+    stats->resources[resource].releases += amount;
+    stats->processes[process].releases += amount;
+    stats->processes[process].held -= amount;
+}
+
+// Function to count instances taken back from a process by preemption
+void recordRevoke(int process, int resource, int amount) {
+    noteResourceUse(resource);
+    stats->processes[process].held -= amount;
+    stats->processes[process].revoked += amount;
+    stats->revokedInstances += amount;
+}
+
+// Function to note that a process exited or was killed
+void recordProcessEnd(int process, int killed) {
+    processStats* ps = &stats->processes[process];
+    unsigned long long now = simulatedNano();
+
+    // a victim still waiting in the queue waited until now
+    if (tables->processes[process].waitingFor != -1 && now > ps->requestTime) {
+        ps->blockedNano += now - ps->requestTime;
+    }
+
+    ps->endTime = now;
+    ps->killed = killed;
+    ps->exited = !killed;
+}
+
+// Function to print the run summary and write it as json next to the logfile
+void writeReport() {
+    struct timespec wallEnd;
+    clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+    double wallSeconds = (wallEnd.tv_sec - wallStart.tv_sec) + (wallEnd.tv_nsec - wallStart.tv_nsec) / 1e9;
+    unsigned long long now = simulatedNano();
+    double simSeconds = now / 1e9;
+
+    // totals and percentiles come from the per resource counters and the histogram
+    int totalRequests = 0, totalGrants = 0, totalReleases = 0, totalBlocked = 0;
+    for (int c = 0; c < NUM_RESOURCES; c++) {
+        noteResourceUse(c);
+        totalRequests += stats->resources[c].requests;
+        totalGrants += stats->resources[c].grants;
+        totalReleases += stats->resources[c].releases;
+        totalBlocked += stats->resources[c].blocked;
+    }
+
+    double percentiles[] = {0.50, 0.90, 0.99};
+    unsigned long long percentileNano[3];
+    unsigned long long waitPercentileNano[3];
+    for (int p = 0; p < 3; p++) {
+        percentileNano[p] = latencyPercentile(stats->grantLatency, percentiles[p]);
+        waitPercentileNano[p] = latencyPercentile(stats->waitLatency, percentiles[p]);
+    }
+    double meanLatency = totalGrants > 0 ? (double)stats->totalGrantLatency / totalGrants : 0;
+    double meanWait = stats->waitedGrants > 0 ? (double)stats->totalWaitLatency / stats->waitedGrants : 0;
+
+    // the summary goes to the screen and the logfile like the other tables
+    FILE* file = openLogFile();
+    FILE* outputs[] = {stdout, file};
+    for (int o = 0; o < 2; o++) {
+        FILE* out = outputs[o];
+        if (out == NULL) {
+            continue;
+        }
+
+        fprintf(out, "\nRun Summary at time %u:%u (%.2f wall seconds)\n", simClock[0], simClock[1], wallSeconds);
+        fprintf(out, "Launched: %d Terminated: %d Victims: %d Detection runs: %d Deadlocks found: %d\n",
+            totalLaunched, totalTerminated, stats->victims, stats->detectionRuns, stats->deadlocksFound);
+        fprintf(out, "Resolution: %s Preemptions: %d Instances revoked: %d\n",
+            resolutionNames[resolution], stats->preemptions, stats->revokedInstances);
+        if (checkpoint != NULL) {
+            fprintf(out, "Checkpoints: %d to %s, mean pause %.1f us\n", checkpointsWritten, checkpointName,
+                checkpointsWritten > 0 ? checkpointPauseNano / checkpointsWritten / 1e3 : 0);
+        }
+        fprintf(out, "Requests: %d Grants: %d Blocked: %d Releases: %d\n",
+            totalRequests, totalGrants, totalBlocked, totalReleases);
+        fprintf(out, "Throughput: %.1f grants per simulated second, %.1f grants per wall second\n",
+            simSeconds > 0 ? totalGrants / simSeconds : 0, wallSeconds > 0 ? totalGrants / wallSeconds : 0);
+        fprintf(out, "Grant latency (ns): mean %.0f p50 <=%llu p90 <=%llu p99 <=%llu max %llu\n",
+            meanLatency, percentileNano[0], percentileNano[1], percentileNano[2], stats->maxGrantLatency);
+        fprintf(out, "Wait latency under %s policy, aging %.2f (ns): waited %llu mean %.0f p50 <=%llu p90 <=%llu p99 <=%llu\n",
+            policyNames[grantPolicy], agingFactor, stats->waitedGrants, meanWait,
+            waitPercentileNano[0], waitPercentileNano[1], waitPercentileNano[2]);
+
+        fprintf(out, "\nGrant latency histogram:\n");
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            if (stats->grantLatency[b] > 0) {
+                fprintf(out, "  <%-14llu %llu\n", b == 0 ? 1ULL : 1ULL << b, stats->grantLatency[b]);
+            }
+        }
+
+        fprintf(out, "\n%-6s%-10s%-8s%-8s%-10s%-10s%-14s%-8s\n",
+            "Proc", "Requests", "Grants", "Waited", "Releases", "PeakHeld", "BlockedMs", "Outcome");
+        for (int i = 0; i < totalLaunched; i++) {
+            processStats* ps = &stats->processes[i];
+            fprintf(out, "P%-5d%-10d%-8d%-8d%-10d%-10d%-14.3f%-8s\n",
+                i, ps->requests, ps->grants, ps->blockedGrants, ps->releases, ps->peakHeld, ps->blockedNano / 1e6,
+                ps->killed ? "killed" : ps->exited ? "exited" : "running");
+        }
+
+        fprintf(out, "\n%-6s%-10s%-8s%-8s%-10s%-10s%-8s\n",
+            "Res", "Requests", "Grants", "Blocked", "Releases", "PeakUse", "Util%");
+        for (int c = 0; c < NUM_RESOURCES; c++) {
+            resourceStats* rs = &stats->resources[c];
+            fprintf(out, "R%-5d%-10d%-8d%-8d%-10d%-10d%-8.1f\n",
+                c, rs->requests, rs->grants, rs->blocked, rs->releases, rs->peakInUse,
+                now > 0 ? 100.0 * rs->busyArea / ((double)RESOURCE_INSTANCES * now) : 0);
+        }
+        fprintf(out, "\n");
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
+
+    // json report named after the logfile
+    char reportName[1024];
+    snprintf(reportName, sizeof(reportName), "%s.json", filename);
+    FILE* report = fopen(reportName, "w");
+    if (report == NULL) {
+        perror("Error opening report file");
+        return;
+    }
+
+    fprintf(report, "{\n  \"simulatedSeconds\": %.6f,\n  \"wallSeconds\": %.6f,\n", simSeconds, wallSeconds);
+    fprintf(report, "  \"launched\": %d,\n  \"terminated\": %d,\n  \"victims\": %d,\n", totalLaunched, totalTerminated, stats->victims);
+    fprintf(report, "  \"detectionRuns\": %d,\n  \"deadlocksFound\": %d,\n", stats->detectionRuns, stats->deadlocksFound);
+    fprintf(report, "  \"resolution\": \"%s\",\n  \"preemptions\": %d,\n  \"revokedInstances\": %d,\n",
+        resolutionNames[resolution], stats->preemptions, stats->revokedInstances);
+    fprintf(report, "  \"requests\": %d,\n  \"grants\": %d,\n  \"blocked\": %d,\n  \"releases\": %d,\n",
+        totalRequests, totalGrants, totalBlocked, totalReleases);
+    fprintf(report, "  \"grantsPerSimulatedSecond\": %.3f,\n  \"grantsPerWallSecond\": %.3f,\n",
+        simSeconds > 0 ? totalGrants / simSeconds : 0, wallSeconds > 0 ? totalGrants / wallSeconds : 0);
+    fprintf(report, "  \"grantLatencyNs\": {\"mean\": %.1f, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"max\": %llu, \"histogram\": [",
+        meanLatency, percentileNano[0], percentileNano[1], percentileNano[2], stats->maxGrantLatency);
+    int firstBucket = 1;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        if (stats->grantLatency[b] > 0) {
+            fprintf(report, "%s{\"below\": %llu, \"count\": %llu}", firstBucket ? "" : ", ",
+                b == 0 ? 1ULL : 1ULL << b, stats->grantLatency[b]);
+            firstBucket = 0;
+        }
+    }
+    fprintf(report, "]},\n  \"grantPolicy\": \"%s\",\n  \"agingFactor\": %.3f,\n", policyNames[grantPolicy], agingFactor);
+    fprintf(report, "  \"waitLatencyNs\": {\"waited\": %llu, \"mean\": %.1f, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu},\n",
+        stats->waitedGrants, meanWait, waitPercentileNano[0], waitPercentileNano[1], waitPercentileNano[2]);
+    fprintf(report, "  \"processes\": [\n");
+    for (int i = 0; i < totalLaunched; i++) {
+        processStats* ps = &stats->processes[i];
+        fprintf(report, "    {\"process\": %d, \"requests\": %d, \"grants\": %d, \"waitedGrants\": %d, \"releases\": %d, "
+            "\"revoked\": %d, \"peakHeld\": %d, \"blockedNs\": %llu, \"outcome\": \"%s\"}%s\n",
+            i, ps->requests, ps->grants, ps->blockedGrants, ps->releases, ps->revoked, ps->peakHeld, ps->blockedNano,
+            ps->killed ? "killed" : ps->exited ? "exited" : "running", i + 1 < totalLaunched ? "," : "");
+    }
+    fprintf(report, "  ],\n  \"resources\": [\n");
+    for (int c = 0; c < NUM_RESOURCES; c++) {
+        resourceStats* rs = &stats->resources[c];
+        fprintf(report, "    {\"resource\": %d, \"requests\": %d, \"grants\": %d, \"blocked\": %d, \"releases\": %d, "
+            "\"peakInUse\": %d, \"utilization\": %.4f}%s\n",
+            c, rs->requests, rs->grants, rs->blocked, rs->releases, rs->peakInUse,
+            now > 0 ? rs->busyArea / ((double)RESOURCE_INSTANCES * now) : 0, c + 1 < NUM_RESOURCES ? "," : "");
+    }
+    fprintf(report, "  ]\n}\n");
+    fclose(report);
+}
+
+// Function to open the logfile for appending, timed since every table dump reopens it
+FILE* openLogFile() {
+    unsigned long long openStart = profileStart(profile);
+    FILE* file = fopen(filename, "a+");
+    profileEnd(profile, PHASE_FOPEN, openStart);
+    return file;
+}
+
+// Function to put a message on the queue, timed as the syscall oss makes most
+void sendMessage(messages* msg) {
+    unsigned long long sendStart = profileStart(profile);
+    int sent = msgsnd(msgqId, msg, sizeof(messages) - sizeof(long), 0);
+    profileEnd(profile, PHASE_MSGSND, sendStart);
+    if (sent == -1) {
+        perror("msgsnd to child failed\n");
+        handleTermination();
+    }
+}
+
+// Function to print the phase timings to the screen and the logfile
+// the shards and workers keep adding while this reads, so a dump taken mid run is close but not exact
+void writeProfile() {
+    // copy first so every column of a row comes from the same moment
+    profilePhase phases[PHASE_COUNT];
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        __atomic_load(&profile[p].count, &phases[p].count, __ATOMIC_RELAXED);
+        __atomic_load(&profile[p].totalNano, &phases[p].totalNano, __ATOMIC_RELAXED);
+        __atomic_load(&profile[p].maxNano, &phases[p].maxNano, __ATOMIC_RELAXED);
+        for (int b = 0; b < PROFILE_BUCKETS; b++) {
+            __atomic_load(&profile[p].buckets[b], &phases[p].buckets[b], __ATOMIC_RELAXED);
+        }
+    }
+    unsigned long long loopNano = phases[PHASE_LOOP].totalNano;
+
+    FILE* file = openLogFile();
+    FILE* outputs[] = {stdout, file};
+    for (int o = 0; o < 2; o++) {
+        FILE* out = outputs[o];
+        if (out == NULL) {
+            continue;
+        }
+
+        fprintf(out, "\nPhase Timings at time %u:%u (ns, percentiles are bucket upper bounds)\n", simClock[0], simClock[1]);
+        fprintf(out, "%-14s%-12s%-10s%-10s%-12s%-12s%-12s%-8s\n",
+            "Phase", "Count", "Mean", "p50", "p99", "Max", "TotalMs", "Loop%");
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            profilePhase* phase = &phases[p];
+            if (phase->count == 0) {
+                continue;
+            }
+
+            // the worker rows run alongside oss so their share of the loop can pass 100
+            fprintf(out, "%-14s%-12llu%-10.0f%-10llu%-12llu%-12llu%-12.3f%-8.1f\n",
+                phaseNames[p], phase->count, (double)phase->totalNano / phase->count,
+                latencyPercentile(phase->buckets, 0.50), latencyPercentile(phase->buckets, 0.99),
+                phase->maxNano, phase->totalNano / 1e6, loopNano > 0 ? 100.0 * phase->totalNano / loopNano : 0);
+        }
+        fprintf(out, "\n");
+        fflush(out);
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
 }
 
 // Function to clean up the code
 void handleTermination() {
     // kill all child processes
     // clean msg queue and shared memory
-    kill(0, SIGTERM);
-    msgctl(msgqId, IPC_RMID, NULL);
-    shmdt(shmPtr);
-    shmctl(shmID, IPC_RMID, NULL);
+    // only signal our own children so other oss runs in this process group survive
+    for (int i = 0; i < totalLaunched && childTable != NULL; i++) {
+        if (childTable[i].occupied == 1) {
+            kill(childTable[i].pid, SIGTERM);
+        }
+    }
+    for (int s = 0; s < shardCount; s++) {
+        if (shardPids[s] > 0 && s != shardIndex) {
+            kill(shardPids[s], SIGTERM);
+        }
+    }
+
+    // only the coordinator reports, once the shards have stopped
+    if (shardIndex == -1 && stats != NULL && filename != NULL) {
+        for (int s = 0; s < shardCount; s++) {
+            waitpid(shardPids[s], NULL, 0);
+        }
+        writeReport();
+        if (profile != NULL) {
+            writeProfile();
+        }
+    }
+
+    // only remove what was made, an id of -1 or 0 could name someone else's object
+    if (msgqId != -1) {
+        msgctl(msgqId, IPC_RMID, NULL);
+    }
+    for (int s = 0; s < shardQueueCount; s++) {
+        msgctl(shardQueues[s], IPC_RMID, NULL);
+    }
+    if (shmPtr != NULL) {
+        shmdt(shmPtr);
+    }
+    if (shmID != -1) {
+        shmctl(shmID, IPC_RMID, NULL);
+    }
+    if (profileID != -1 && shardIndex == -1) {
+        shmctl(profileID, IPC_RMID, NULL);
+    }
+    if (checkpoint != NULL && shardIndex == -1) {
+        checkpoint->owner.pid = 0;
+    }
     exit(0);
-}
\ No newline at end of file
+}
+
+// Function to map the checkpoint file
+// a new run starts it over, a restart checks it was written by this build's table shape
+void openCheckpoint() {
+    // the workers must not inherit the lock, see runShard for the shards
+    int fd = open(checkpointName, (restartRun == 1 ? O_RDWR : O_RDWR | O_CREAT) | O_CLOEXEC, PERMS);
+    if (fd == -1) {
+        perror("Unable to open the checkpoint file.\n");
+        exit(1);
+    }
+
+    // one oss per checkpoint file, new run or restart, the lock goes away with the oss
+    // even when it is killed, so a crashed run never keeps its file locked
+    if (flock(fd, LOCK_EX | LOCK_NB) == -1) {
+        if (errno == EWOULDBLOCK) {
+            printf("checkpoint file %s is in use by another oss\n", checkpointName);
+        }
+        else {
+            perror("Unable to lock the checkpoint file.\n");
+        }
+        close(fd);
+        exit(1);
+    }
+    checkpointFd = fd;
+
+    if (restartRun == 0 && ftruncate(fd, sizeof(checkpointFile)) == -1) {
+        perror("Unable to size the checkpoint file.\n");
+        close(fd);
+        exit(1);
+    }
+
+    // any other size is a different layout, even when the shape matches
+    struct stat info;
+    if (fstat(fd, &info) == -1 || info.st_size != (off_t)sizeof(checkpointFile)) {
+        printf("checkpoint file %s is not a checkpoint from this build\n", checkpointName);
+        close(fd);
+        exit(1);
+    }
+
+    checkpoint = (checkpointFile*)mmap(NULL, sizeof(checkpointFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (checkpoint == MAP_FAILED) {
+        checkpoint = NULL;
+        perror("Unable to map the checkpoint file.\n");
+        exit(1);
+    }
+
+    if (restartRun == 0) {
+        memset(checkpoint, 0, sizeof(checkpointFile));
+        checkpoint->magic = CHECKPOINT_MAGIC;
+        checkpoint->version = CHECKPOINT_VERSION;
+        checkpoint->numResources = NUM_RESOURCES;
+        checkpoint->maxProcesses = MAX_PROCESSES;
+        checkpoint->resourceInstances = RESOURCE_INSTANCES;
+        checkpoint->kernels = CHECKPOINT_KERNELS;
+        checkpoint->fileSize = sizeof(checkpointFile);
+        checkpoint->current = -1;
+        checkpoint->owner.pid = 0;
+        recordOwnedIds();
+        return;
+    }
+
+    if (checkpoint->magic != CHECKPOINT_MAGIC || checkpoint->version != CHECKPOINT_VERSION
+        || checkpoint->numResources != NUM_RESOURCES || checkpoint->maxProcesses != MAX_PROCESSES
+        || checkpoint->resourceInstances != RESOURCE_INSTANCES || checkpoint->kernels != CHECKPOINT_KERNELS
+        || checkpoint->fileSize != sizeof(checkpointFile)) {
+        printf("checkpoint file %s is not a checkpoint from this build\n", checkpointName);
+        exit(1);
+    }
+    if (checkpoint->current != 0 && checkpoint->current != 1) {
+        printf("checkpoint file %s has no complete checkpoint\n", checkpointName);
+        exit(1);
+    }
+
+    clearStaleRun();
+    memset(&checkpoint->owner, 0, sizeof(checkpointOwner));
+    recordOwnedIds();
+}
+
+// Function to copy the ids this oss has made into the checkpoint file
+// the file is mapped shared, so the record survives oss being killed
+void recordOwnedIds() {
+    if (checkpoint == NULL || shardIndex != -1) {
+        return;
+    }
+
+    checkpointOwner* owner = &checkpoint->owner;
+    if (owner->msgqId != msgqId) {
+        owner->msgqId = msgqId;
+        owner->msgqCreated = queueCreated(msgqId);
+    }
+    owner->shmID = shmID;
+    owner->profileID = profileID;
+    for (int s = owner->shardQueueCount; s < shardQueueCount; s++) {
+        owner->shardQueues[s] = shardQueues[s];
+        owner->shardQueueCreated[s] = queueCreated(shardQueues[s]);
+    }
+    owner->shardQueueCount = shardQueueCount;
+    for (int s = 0; s < shardCount; s++) {
+        if (shardPids[s] > 0 && owner->shardPids[s] != shardPids[s]) {
+            owner->shardPids[s] = shardPids[s];
+            owner->shardStarts[s] = processStart(shardPids[s]);
+        }
+    }
+    __atomic_store_n(&owner->pid, getpid(), __ATOMIC_RELEASE);
+}
+
+// Function to drop a worker that has ended from the owner record
+// its pid can be reused by anyone, so a restart must never signal it
+void forgetWorker(int slot) {
+    if (checkpoint != NULL) {
+        checkpoint->owner.workerPids[slot] = 0;
+        checkpoint->owner.workerStarts[slot] = 0;
+    }
+}
+
+// Function to stop the processes and remove the IPC objects of the oss that wrote the checkpoint
+// a pid is only signalled while it has the start time it was recorded with, a queue only
+// removed while it has the recorded creation time and a segment while the recorded oss is its creator
+void clearStaleRun() {
+    checkpointOwner* owner = &checkpoint->owner;
+    if (owner->pid == 0) {
+        return; // it exited normally and cleaned up after itself
+    }
+
+    int stopped = 0;
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        if (owner->workerPids[i] > 0 && owner->workerStarts[i] != 0
+            && processStart(owner->workerPids[i]) == owner->workerStarts[i]) {
+            kill(owner->workerPids[i], SIGKILL);
+            stopped += 1;
+        }
+    }
+    for (int s = 0; s < MAX_SHARDS; s++) {
+        if (owner->shardPids[s] > 0 && owner->shardStarts[s] != 0
+            && processStart(owner->shardPids[s]) == owner->shardStarts[s]) {
+            kill(owner->shardPids[s], SIGKILL);
+            stopped += 1;
+        }
+    }
+
+    int removed = 0;
+    if (owner->msgqId != -1 && owner->msgqCreated != 0 && queueCreated(owner->msgqId) == owner->msgqCreated
+        && msgctl(owner->msgqId, IPC_RMID, NULL) == 0) {
+        removed += 1;
+    }
+    for (int s = 0; s < owner->shardQueueCount && s < MAX_SHARDS; s++) {
+        if (owner->shardQueueCreated[s] != 0 && queueCreated(owner->shardQueues[s]) == owner->shardQueueCreated[s]
+            && msgctl(owner->shardQueues[s], IPC_RMID, NULL) == 0) {
+            removed += 1;
+        }
+    }
+    int segments[2] = {owner->shmID, owner->profileID};
+    for (int k = 0; k < 2; k++) {
+        struct shmid_ds info;
+        if (segments[k] != -1 && shmctl(segments[k], IPC_STAT, &info) == 0 && info.shm_cpid == owner->pid
+            && shmctl(segments[k], IPC_RMID, NULL) == 0) {
+            removed += 1;
+        }
+    }
+
+    printf("Master cleared the run of oss %d: stopped %d processes, removed %d IPC objects\n",
+        (int)owner->pid, stopped, removed);
+}
+
+// Function to get when a process started, in clock ticks since boot, 0 when it is gone
+// a pid and its start time name one process, a zombie counts as gone
+unsigned long long processStart(pid_t pid) {
+    char path[64];
+    char line[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    char* read = fgets(line, sizeof(line), file);
+    fclose(file);
+
+    // the name can hold spaces and parentheses, the fields start after the last one
+    char* fields = read == NULL ? NULL : strrchr(line, ')');
+    char processState = 'Z';
+    unsigned long long start = 0;
+    if (fields == NULL || sscanf(fields + 1, " %c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu",
+        &processState, &start) != 2 || processState == 'Z') {
+        return 0;
+    }
+    return start;
+}
+
+// Function to get when a message queue was created, 0 when it is gone or not ours
+// msg_ctime only changes on IPC_SET, which oss never does
+time_t queueCreated(int id) {
+    struct msqid_ds info;
+    if (msgctl(id, IPC_STAT, &info) == -1 || info.msg_perm.cuid != getuid()) {
+        return 0;
+    }
+    return info.msg_ctime;
+}
+
+// Function to copy the manager state into the free checkpoint slot
+// the shards are held only for the copy, the kernel writes the pages out afterwards
+void writeCheckpoint() {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int slot = checkpoint->current == 0 ? 1 : 0;
+    checkpointSlot* target = &checkpoint->slots[slot];
+    target->sequence = 0;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    lockAllShards();
+    memcpy(state->clock, simClock, sizeof(unsigned int) * 2);
+    memcpy(&target->state, state, sizeof(sharedState));
+    unlockAllShards();
+
+    checkpointCounters* counters = &target->counters;
+    counters->processCount = processCount;
+    counters->simultaneousCount = simultaneousCount;
+    counters->processSpawnRate = processSpawnRate;
+    counters->totalLaunched = totalLaunched;
+    counters->totalTerminated = totalTerminated;
+    counters->launchTimePassed = launchTimePassed;
+    counters->oneSecondPassed = oneSecondPassed;
+    counters->quarterSecondPassed = quarterSecondPassed;
+    counters->grantPolicy = grantPolicy;
+    counters->agingFactor = agingFactor;
+    counters->resolution = resolution;
+    memcpy(counters->workloadSpec, workloadSpec, sizeof(workloadSpec));
+    counters->workloadSeed = workloadSeed;
+
+    // publish the slot only once it is complete
+    checkpointSequence += 1;
+    __atomic_store_n(&target->sequence, checkpointSequence, __ATOMIC_RELEASE);
+    __atomic_store_n(&checkpoint->current, slot, __ATOMIC_RELEASE);
+    msync(checkpoint, sizeof(checkpointFile), MS_ASYNC);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    checkpointsWritten += 1;
+    checkpointPauseNano += (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    nextCheckpointNano = simulatedNano() + (unsigned long long)(checkpointInterval * 1e9);
+}
+
+// Function to load the tables, clock and counters from the latest checkpoint
+void restoreCheckpoint() {
+    checkpointSlot* source = &checkpoint->slots[checkpoint->current];
+    checkpointSequence = source->sequence;
+
+    // everything but the shard locks, which were set up fresh
+    memcpy(state->clock, source->state.clock, sizeof(state->clock));
+    memcpy(state->childTable, source->state.childTable, sizeof(state->childTable));
+    memcpy(state->allResources, source->state.allResources, sizeof(state->allResources));
+    state->index = source->state.index;
+    state->stats = source->state.stats;
+    memcpy(simClock, state->clock, sizeof(unsigned int) * 2);
+
+    checkpointCounters* counters = &source->counters;
+    processCount = counters->processCount;
+    simultaneousCount = counters->simultaneousCount;
+    processSpawnRate = counters->processSpawnRate;
+    totalLaunched = counters->totalLaunched;
+    totalTerminated = counters->totalTerminated;
+    launchTimePassed = counters->launchTimePassed;
+    oneSecondPassed = counters->oneSecondPassed;
+    quarterSecondPassed = counters->quarterSecondPassed;
+    grantPolicy = counters->grantPolicy;
+    agingFactor = counters->agingFactor;
+    resolution = counters->resolution;
+    memcpy(workloadSpec, counters->workloadSpec, sizeof(workloadSpec));
+    workloadSeed = counters->workloadSeed;
+    nextCheckpointNano = simulatedNano() + (unsigned long long)(checkpointInterval * 1e9);
+}
+
+// Function to start a new worker for every process that was running at the checkpoint
+// each one starts with the instances its slot holds, a request it was waiting on is
+// dropped and the new worker asks again when it wants to
+void relaunchWorkers() {
+    FILE* file = openLogFile();
+    if (file == NULL) {
+        perror("Error opening file");
+        handleTermination();
+    }
+
+    fprintf(file, "Master resuming from checkpoint %llu at time %u:%u\n", checkpointSequence, simClock[0], simClock[1]);
+    printf("Master resuming from checkpoint %llu at time %u:%u\n", checkpointSequence, simClock[0], simClock[1]);
+
+    for (int i = 0; i < totalLaunched; i++) {
+        if (childTable[i].occupied == 0) {
+            continue;
+        }
+
+        removeWaiter(i);
+        childTable[i].expectingResponse = 0;
+
+        char heldArg[NUM_RESOURCES * 12] = "";
+        for (int c = 0; c < NUM_RESOURCES; c++) {
+            sprintf(heldArg + strlen(heldArg), c == 0 ? "%d" : ":%d", allocationOf(tables, c, i));
+        }
+
+        childTable[i].pid = startWorker(i, heldArg);
+        fprintf(file, "Master relaunched P%d holding %s\n", i, heldArg);
+        printf("Master relaunched P%d holding %s\n", i, heldArg);
+    }
+
+    fprintf(file, "\n");
+    printf("\n");
+    fclose(file);
+}
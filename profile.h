@@ -0,0 +1,73 @@
+// Phase timing shared by oss, its shards and the workers
+// Date: October 19, 2026
+
+// the phases live in their own shared memory segment, which oss only creates when
+// profiling is switched on, everyone adds to it as they go so nothing is lost
+// when a worker is killed, with profiling off every hook is one branch
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <time.h>
+
+#define PROFILE_BUCKETS 48 // log2 buckets like the latency histograms, bucket 0 holds 0
+
+// timed phases, the names are in oss
+enum {
+    PHASE_LOOP,         // one main loop iteration
+    PHASE_CLOCK,        // clock update, includes the tick wait in real time mode
+    PHASE_LAUNCH,       // forking a worker
+    PHASE_REAP,         // waitpid sweep and releasing what exited workers held
+    PHASE_HANDLE,       // serving a request or release in a shard
+    PHASE_DISPATCH,     // sending go-aheads to idle workers
+    PHASE_DETECT,       // grant pass and deadlock detection
+    PHASE_CHECKPOINT,
+    PHASE_DISPLAY,      // process and resource tables
+    PHASE_LOCK,         // waiting for a shard lock
+    PHASE_MSGSND,       // msgsnd from oss or a shard
+    PHASE_WAITPID,
+    PHASE_FOPEN,        // opening the logfile
+    PHASE_WORKER_SPIN,  // worker polling the clock until its next decision
+    PHASE_WORKER_SEND,  // worker msgsnd
+    PHASE_WORKER_REPLY, // worker blocked until oss answers
+    PHASE_COUNT
+};
+
+typedef struct profilePhase {
+    unsigned long long count;
+    unsigned long long totalNano;
+    unsigned long long maxNano;
+    unsigned long long buckets[PROFILE_BUCKETS];
+} profilePhase;
+
+// Function to start timing a phase, returns 0 without reading the clock when profiling is off
+static inline unsigned long long profileStart(profilePhase* profile) {
+    if (profile == NULL) {
+        return 0;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Function to add the time since profileStart to a phase
+// several processes add at once so every update is atomic
+static inline void profileEnd(profilePhase* profile, int phase, unsigned long long start) {
+    if (profile == NULL) {
+        return;
+    }
+
+    unsigned long long elapsed = profileStart(profile) - start;
+    int bucket = elapsed == 0 ? 0 : 64 - __builtin_clzll(elapsed);
+    bucket = bucket < PROFILE_BUCKETS ? bucket : PROFILE_BUCKETS - 1;
+
+    profilePhase* p = &profile[phase];
+    __atomic_fetch_add(&p->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&p->totalNano, elapsed, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&p->buckets[bucket], 1, __ATOMIC_RELAXED);
+    unsigned long long longest = __atomic_load_n(&p->maxNano, __ATOMIC_RELAXED);
+    while (elapsed > longest && !__atomic_compare_exchange_n(&p->maxNano, &longest, elapsed, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+#endif
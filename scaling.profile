@@ -0,0 +1,5 @@
+# steady request load for measuring grants per second against the shard count
+# workers never exit and decide every 20us, so serving requests is the bottleneck
+term_pct=0
+hold_ns=200000
+decision_ns=20000
@@ -0,0 +1,421 @@
+// Parameter sweep driver for oss
+// Date: October 19, 2026
+
+#include <stdio.h>
+#include <errno.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/types.h>
+#include <string.h>
+
+#define MAX_VALUES 32
+#define MAX_AXES 8      // entries in axes[], checked below
+#define MAX_RUNS 4096
+
+// one axis of the grid, the values as given on the command line
+typedef struct axis {
+    char flag;              // oss flag the values are passed with
+    const char* name;       // csv column name
+    char* values[MAX_VALUES];
+    int count;
+} axis;
+
+// one oss run and what its json report said
+typedef struct run {
+    int axisValue[MAX_AXES]; // index into each axis' values
+    char* seed;
+    pid_t pid;
+    int finished;
+    int failed;
+    double simulatedSeconds;
+    double wallSeconds;
+    double grants;
+    double grantsPerSimulatedSecond;
+    double grantsPerWallSecond;
+    double deadlocksFound;
+    double victims;
+    double preemptions;
+    double terminated;
+    double grantP50;
+    double grantP99;
+    double waitMean;
+    double waitP99;
+} run;
+
+// grid axes, an axis with no values is left to the oss default
+axis axes[] = {
+    {'n', "proc"},
+    {'s', "simul"},
+    {'t', "spawnRate"},
+    {'S', "shards"},
+    {'p', "policy"},
+    {'w', "workload"},
+    {'r', "speed"},
+    {'d', "resolution"},
+};
+int axisCount = sizeof(axes) / sizeof(axes[0]);
+_Static_assert(sizeof(axes) / sizeof(axes[0]) == MAX_AXES, "MAX_AXES must be the number of grid axes");
+
+char* seeds[MAX_VALUES];
+int seedCount = 0;
+
+run runs[MAX_RUNS];
+int runCount = 0;
+
+char* ossPath = "./oss";
+char* outputBase = "sweep";
+char runDirectory[] = "/tmp/ossSweepXXXXXX";
+int jobs = 0;
+int keepLogs = 0;
+
+// Function prototypes
+int splitValues(char* list, char** values);
+int maxValue(const axis* values, int fallback);
+void buildRuns();
+void startRun(int r);
+void collectRun(int r);
+double jsonNumber(const char* text, const char* section, const char* key);
+void writeResults();
+void logName(int r, char* name, int size);
+
+int main(int argc, char** argv) {
+    // check arguments
+    char defaultSeed[] = "1";
+    int argument;
+    while ((argument = getopt(argc, argv, "hn:s:t:S:p:w:r:d:e:j:o:x:k")) != -1) {
+        switch (argument) {
+            case 'h':
+                printf("\nsweep [-h] [-n procs] [-s simuls] [-t rates] [-S shards] [-p policies] [-w workloads]\n"
+                    "      [-r speeds] [-d resolutions] [-e seeds] [-j jobs] [-o output] [-x oss] [-k]\n");
+                printf("every grid option takes a comma separated list, one oss run is made per combination and seed\n"
+                    "e is the list of workload seeds (default 1)\n"
+                    "j is how many runs go at once (default the cores over the processes of the largest run)\n"
+                    "o is the output name, results go to output.csv and output.json (default sweep)\n"
+                    "x is the oss binary (default ./oss)\n"
+                    "k keeps each run's logfile and json report\n\n");
+                exit(0);
+            case 'e':
+                seedCount = splitValues(optarg, seeds);
+                break;
+            case 'j':
+                jobs = atoi(optarg);
+                break;
+            case 'o':
+                outputBase = optarg;
+                break;
+            case 'x':
+                ossPath = optarg;
+                break;
+            case 'k':
+                keepLogs = 1;
+                break;
+            default: {
+                int found = 0;
+                for (int a = 0; a < axisCount; a++) {
+                    if (axes[a].flag == argument) {
+                        axes[a].count = splitValues(optarg, axes[a].values);
+                        found = 1;
+                    }
+                }
+                if (found == 0) {
+                    printf("invalid commands\n");
+                    exit(1);
+                }
+            }
+        }
+    }
+
+    // oss refuses to run without these
+    if (axes[0].count == 0 || axes[1].count == 0 || axes[2].count == 0) {
+        printf("sweep needs at least -n, -s and -t\n");
+        exit(1);
+    }
+
+    if (seedCount == 0) {
+        seeds[0] = defaultSeed;
+        seedCount = 1;
+    }
+
+    // by default only run as many at once as the cores can hold without time slicing,
+    // each run is oss, its shards and up to simul workers, and an oversubscribed run
+    // moves its clock slower so its simulated seconds would depend on -j
+    if (jobs <= 0) {
+        int perRun = 1 + maxValue(&axes[1], 1) + maxValue(&axes[3], 1);
+        jobs = sysconf(_SC_NPROCESSORS_ONLN) / perRun;
+        if (jobs <= 0) {
+            jobs = 1;
+        }
+    }
+
+    if (mkdtemp(runDirectory) == NULL) {
+        perror("Unable to create the run directory");
+        exit(1);
+    }
+
+    buildRuns();
+    printf("sweep: %d runs, %d at a time, logs in %s\n", runCount, jobs, runDirectory);
+
+    // keep up to jobs runs going until every run is collected
+    int nextRun = 0;
+    int running = 0;
+    int collected = 0;
+    while (collected < runCount) {
+        while (running < jobs && nextRun < runCount) {
+            startRun(nextRun);
+            nextRun += 1;
+            running += 1;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        if (pid == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("wait error in sweep");
+            exit(1);
+        }
+
+        for (int r = 0; r < runCount; r++) {
+            if (runs[r].pid == pid && runs[r].finished == 0) {
+                runs[r].failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+                collectRun(r);
+                running -= 1;
+                collected += 1;
+                printf("sweep: run %d of %d done%s\n", collected, runCount, runs[r].failed ? " (failed)" : "");
+            }
+        }
+    }
+
+    writeResults();
+
+    if (keepLogs == 0) {
+        rmdir(runDirectory);
+    }
+    return 0;
+}
+
+// Function to split a comma separated list in place
+// more values than fit is an error rather than a grid that quietly skips some
+int splitValues(char* list, char** values) {
+    int count = 0;
+    for (char* token = strtok(list, ","); token != NULL; token = strtok(NULL, ",")) {
+        if (count == MAX_VALUES) {
+            printf("sweep takes at most %d values per list\n", MAX_VALUES);
+            exit(1);
+        }
+        values[count] = token;
+        count += 1;
+    }
+    return count;
+}
+
+// Function to get the largest number on an axis, fallback when it has none
+int maxValue(const axis* values, int fallback) {
+    int largest = values->count == 0 ? fallback : 0;
+    for (int v = 0; v < values->count; v++) {
+        if (atoi(values->values[v]) > largest) {
+            largest = atoi(values->values[v]);
+        }
+    }
+    return largest;
+}
+
+// Function to make one run for every combination of axis values and seed
+void buildRuns() {
+    int position[MAX_AXES] = {0};
+    while (1) {
+        for (int e = 0; e < seedCount; e++) {
+            if (runCount == MAX_RUNS) {
+                printf("sweep grid has more than %d runs\n", MAX_RUNS);
+                exit(1);
+            }
+
+            memset(&runs[runCount], 0, sizeof(run));
+            memcpy(runs[runCount].axisValue, position, sizeof(position));
+            runs[runCount].seed = seeds[e];
+            runCount += 1;
+        }
+
+        // step to the next combination like an odometer
+        int a = 0;
+        while (a < axisCount) {
+            position[a] += 1;
+            if (position[a] < axes[a].count) {
+                break;
+            }
+            position[a] = 0;
+            a += 1;
+        }
+        if (a == axisCount) {
+            return;
+        }
+    }
+}
+
+// Function to get the logfile name of a run, its json report is this name plus .json
+void logName(int r, char* name, int size) {
+    snprintf(name, size, "%s/run%d.txt", runDirectory, r);
+}
+
+// Function to start one oss run with its output thrown away
+void startRun(int r) {
+    char logfile[256];
+    logName(r, logfile, sizeof(logfile));
+
+    // oss wants the logfile to exist already
+    FILE* file = fopen(logfile, "w");
+    if (file == NULL) {
+        perror("Unable to create a run logfile");
+        exit(1);
+    }
+    fclose(file);
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("Unable to fork a run");
+        exit(1);
+    }
+    else if (pid == 0)
+    {
+        char* args[2 * MAX_AXES + 6] = {ossPath, "-f", logfile};
+        int argCount = 3;
+        char flags[MAX_AXES][3];
+        for (int a = 0; a < axisCount; a++) {
+            if (axes[a].count > 0) {
+                sprintf(flags[a], "-%c", axes[a].flag);
+                args[argCount++] = flags[a];
+                args[argCount++] = axes[a].values[runs[r].axisValue[a]];
+            }
+        }
+
+        // the seed is added as one more workload setting
+        char seedArg[64];
+        snprintf(seedArg, sizeof(seedArg), "seed=%s", runs[r].seed);
+        args[argCount++] = "-w";
+        args[argCount++] = seedArg;
+        args[argCount] = NULL;
+
+        // runs share our terminal for Ctrl-C but not its output
+        int devNull = open("/dev/null", O_WRONLY);
+        dup2(devNull, STDOUT_FILENO);
+        dup2(devNull, STDERR_FILENO);
+        execv(args[0], args);
+        _exit(127);
+    }
+
+    runs[r].pid = pid;
+}
+
+// Function to read a run's json report and remove its files
+void collectRun(int r) {
+    run* result = &runs[r];
+    result->finished = 1;
+
+    char logfile[256];
+    char reportName[300];
+    logName(r, logfile, sizeof(logfile));
+    snprintf(reportName, sizeof(reportName), "%s.json", logfile);
+
+    FILE* report = fopen(reportName, "r");
+    if (report == NULL) {
+        result->failed = 1;
+    }
+    else
+    {
+        char text[65536];
+        size_t length = fread(text, 1, sizeof(text) - 1, report);
+        text[length] = '\0';
+        fclose(report);
+
+        result->simulatedSeconds = jsonNumber(text, NULL, "simulatedSeconds");
+        result->wallSeconds = jsonNumber(text, NULL, "wallSeconds");
+        result->grants = jsonNumber(text, NULL, "grants");
+        result->grantsPerSimulatedSecond = jsonNumber(text, NULL, "grantsPerSimulatedSecond");
+        result->grantsPerWallSecond = jsonNumber(text, NULL, "grantsPerWallSecond");
+        result->deadlocksFound = jsonNumber(text, NULL, "deadlocksFound");
+        result->victims = jsonNumber(text, NULL, "victims");
+        result->preemptions = jsonNumber(text, NULL, "preemptions");
+        result->terminated = jsonNumber(text, NULL, "terminated");
+        result->grantP50 = jsonNumber(text, "grantLatencyNs", "p50");
+        result->grantP99 = jsonNumber(text, "grantLatencyNs", "p99");
+        result->waitMean = jsonNumber(text, "waitLatencyNs", "mean");
+        result->waitP99 = jsonNumber(text, "waitLatencyNs", "p99");
+    }
+
+    if (keepLogs == 0) {
+        unlink(logfile);
+        unlink(reportName);
+    }
+}
+
+// Function to find "key": number in a report, after "section" when one is given
+double jsonNumber(const char* text, const char* section, const char* key) {
+    char pattern[128];
+    if (section != NULL) {
+        snprintf(pattern, sizeof(pattern), "\"%s\":", section);
+        text = strstr(text, pattern);
+        if (text == NULL) {
+            return 0;
+        }
+    }
+
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char* found = strstr(text, pattern);
+    return found == NULL ? 0 : atof(found + strlen(pattern));
+}
+
+// Function to write every run to output.csv and output.json
+void writeResults() {
+    char csvName[256];
+    char jsonName[256];
+    snprintf(csvName, sizeof(csvName), "%s.csv", outputBase);
+    snprintf(jsonName, sizeof(jsonName), "%s.json", outputBase);
+
+    FILE* csv = fopen(csvName, "w");
+    FILE* json = fopen(jsonName, "w");
+    if (csv == NULL || json == NULL) {
+        perror("Unable to open the sweep output");
+        exit(1);
+    }
+
+    for (int a = 0; a < axisCount; a++) {
+        fprintf(csv, "%s,", axes[a].name);
+    }
+    fprintf(csv, "seed,status,simulatedSeconds,wallSeconds,grants,grantsPerSimulatedSecond,grantsPerWallSecond,"
+        "deadlocksFound,victims,preemptions,terminated,grantP50Ns,grantP99Ns,waitMeanNs,waitP99Ns\n");
+    fprintf(json, "[\n");
+
+    for (int r = 0; r < runCount; r++) {
+        run* result = &runs[r];
+        fprintf(json, "  {");
+        for (int a = 0; a < axisCount; a++) {
+            const char* value = axes[a].count > 0 ? axes[a].values[result->axisValue[a]] : "";
+            fprintf(csv, "%s,", value);
+            fprintf(json, "\"%s\": \"%s\", ", axes[a].name, value);
+        }
+
+        fprintf(csv, "%s,%s,%.6f,%.6f,%.0f,%.3f,%.3f,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%.1f,%.0f\n",
+            result->seed, result->failed ? "failed" : "ok", result->simulatedSeconds, result->wallSeconds,
+            result->grants, result->grantsPerSimulatedSecond, result->grantsPerWallSecond,
+            result->deadlocksFound, result->victims, result->preemptions, result->terminated,
+            result->grantP50, result->grantP99, result->waitMean, result->waitP99);
+        fprintf(json, "\"seed\": \"%s\", \"status\": \"%s\", \"simulatedSeconds\": %.6f, \"wallSeconds\": %.6f, "
+            "\"grants\": %.0f, \"grantsPerSimulatedSecond\": %.3f, \"grantsPerWallSecond\": %.3f, "
+            "\"deadlocksFound\": %.0f, \"victims\": %.0f, \"preemptions\": %.0f, \"terminated\": %.0f, "
+            "\"grantP50Ns\": %.0f, \"grantP99Ns\": %.0f, \"waitMeanNs\": %.1f, \"waitP99Ns\": %.0f}%s\n",
+            result->seed, result->failed ? "failed" : "ok", result->simulatedSeconds, result->wallSeconds,
+            result->grants, result->grantsPerSimulatedSecond, result->grantsPerWallSecond,
+            result->deadlocksFound, result->victims, result->preemptions, result->terminated,
+            result->grantP50, result->grantP99, result->waitMean, result->waitP99,
+            r + 1 < runCount ? "," : "");
+    }
+
+    fprintf(json, "]\n");
+    fclose(csv);
+    fclose(json);
+    printf("sweep: results written to %s and %s\n", csvName, jsonName);
+}
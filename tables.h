@@ -0,0 +1,319 @@
+// Table shape shared by oss, the workers and the kernel benchmark
+// Date: October 19, 2026
+
+// every size can be overridden at build time, e.g. make SHAPE="-DNUM_RESOURCES=16 -DMAX_PROCESSES=32"
+
+#ifndef TABLES_H
+#define TABLES_H
+
+#include <stdint.h>
+
+#ifndef NUM_RESOURCES
+#define NUM_RESOURCES 10        // resource classes R0, R1, etc
+#endif
+
+#ifndef MAX_PROCESSES
+#define MAX_PROCESSES 18        // slots in the process table
+#endif
+
+#ifndef RESOURCE_INSTANCES
+#define RESOURCE_INSTANCES 20   // instances of each resource class
+#endif
+
+#ifndef MAX_SHARDS
+#define MAX_SHARDS 10           // most shard processes, oss and the workers size their queue lists by it
+#endif
+
+// the common shapes get the unrolled kernels in kernels.h, which keep the holders and
+// waiters of each class as one word of process bits, define GENERIC_KERNELS to turn them off
+#if !defined(GENERIC_KERNELS) && ( \
+    (NUM_RESOURCES == 10 && MAX_PROCESSES == 18) || \
+    (NUM_RESOURCES == 16 && MAX_PROCESSES == 32) || \
+    (NUM_RESOURCES == 32 && MAX_PROCESSES == 64))
+#define UNROLLED_KERNELS 1
+#endif
+
+// every holder of a class has at least one of its instances, so a class never has
+// more holders than instances or processes, each class gets its own slice of that many
+// holdings so shards never share a free list
+#define CLASS_HOLDERS (RESOURCE_INSTANCES < MAX_PROCESSES ? RESOURCE_INSTANCES : MAX_PROCESSES)
+#define MAX_HOLDINGS (NUM_RESOURCES * CLASS_HOLDERS)
+
+// instances of one resource class held by one process
+// each holding is in its process's held list and its resource's holder list
+typedef struct holding {
+    int process;
+    int resource;
+    int amount;
+    int nextHeld;     // same process, -1 at the end, also chains the free holdings of a class
+    int prevHeld;
+    int nextHolder;   // same resource, -1 at the end
+    int prevHolder;
+} holding;
+
+// what one process holds and waits on, and its place in its resource's wait queue
+typedef struct processEntry {
+    int firstHeld;    // holding at the head of the held list, -1 when nothing is held
+    int heldCount;
+    int waitingFor;   // resource waited on, -1 when none
+    double waitKey;   // grant priority while waiting, lower goes first
+    int heapChild;    // pairing heap links, -1 when unused
+    int heapSibling;
+    int heapPrev;     // parent for a first child, otherwise the sibling before
+} processEntry;
+
+// sparse allocation and request tables
+// the holdings only take room for what is actually held, a process waits on at most one
+// resource so the wait queues are linked through the process entries
+typedef struct tableIndex {
+    holding holdings[MAX_HOLDINGS];
+    int firstFree[NUM_RESOURCES];     // first unused holding in each class's slice
+    processEntry processes[MAX_PROCESSES];
+    int firstHolder[NUM_RESOURCES];   // holding at the head of each holder list, -1 when none
+    int holderCount[NUM_RESOURCES];
+    int waiterRoot[NUM_RESOURCES];    // process that goes first in each wait queue, -1 when empty
+    int waiterCount[NUM_RESOURCES];
+#ifdef UNROLLED_KERNELS
+    uint64_t holderMask[NUM_RESOURCES];  // holders again as bits, every unrolled shape fits one word
+    uint64_t waiterMask[NUM_RESOURCES];
+#endif
+} tableIndex;
+
+// Function to empty the tables, nothing is held or waited on
+static inline void clearTables(tableIndex* index) {
+    for (int h = 0; h < MAX_HOLDINGS; h++) {
+        index->holdings[h].nextHeld = (h + 1) % CLASS_HOLDERS != 0 ? h + 1 : -1;
+    }
+
+    for (int p = 0; p < MAX_PROCESSES; p++) {
+        processEntry* entry = &index->processes[p];
+        entry->firstHeld = -1;
+        entry->heldCount = 0;
+        entry->waitingFor = -1;
+        entry->waitKey = 0;
+        entry->heapChild = entry->heapSibling = entry->heapPrev = -1;
+    }
+
+    for (int c = 0; c < NUM_RESOURCES; c++) {
+        index->firstFree[c] = c * CLASS_HOLDERS;
+        index->firstHolder[c] = -1;
+        index->holderCount[c] = 0;
+        index->waiterRoot[c] = -1;
+        index->waiterCount[c] = 0;
+#ifdef UNROLLED_KERNELS
+        index->holderMask[c] = 0;
+        index->waiterMask[c] = 0;
+#endif
+    }
+}
+
+// Function to find a process's holding of a resource, -1 when it holds none
+// walks the held list, which is only as long as the classes the process holds
+static inline int findHolding(const tableIndex* index, int resource, int process) {
+    for (int h = index->processes[process].firstHeld; h != -1; h = index->holdings[h].nextHeld) {
+        if (index->holdings[h].resource == resource) {
+            return h;
+        }
+    }
+    return -1;
+}
+
+// Function to get how many instances of a resource a process holds
+static inline int allocationOf(const tableIndex* index, int resource, int process) {
+    int h = findHolding(index, resource, process);
+    return h == -1 ? 0 : index->holdings[h].amount;
+}
+
+// Function to take a holding out of both lists and give it back to the free list
+static inline void freeHolding(tableIndex* index, int h) {
+    holding* entry = &index->holdings[h];
+    processEntry* owner = &index->processes[entry->process];
+
+    if (entry->prevHeld != -1) {
+        index->holdings[entry->prevHeld].nextHeld = entry->nextHeld;
+    }
+    else {
+        owner->firstHeld = entry->nextHeld;
+    }
+    if (entry->nextHeld != -1) {
+        index->holdings[entry->nextHeld].prevHeld = entry->prevHeld;
+    }
+    owner->heldCount -= 1;
+
+    if (entry->prevHolder != -1) {
+        index->holdings[entry->prevHolder].nextHolder = entry->nextHolder;
+    }
+    else {
+        index->firstHolder[entry->resource] = entry->nextHolder;
+    }
+    if (entry->nextHolder != -1) {
+        index->holdings[entry->nextHolder].prevHolder = entry->prevHolder;
+    }
+    index->holderCount[entry->resource] -= 1;
+#ifdef UNROLLED_KERNELS
+    index->holderMask[entry->resource] &= ~((uint64_t)1 << entry->process);
+#endif
+
+    entry->nextHeld = index->firstFree[entry->resource];
+    index->firstFree[entry->resource] = h;
+}
+
+// Function to change how many instances of a resource a process holds
+// the first instance adds a holding to both lists and the last one frees it
+static inline void changeHolding(tableIndex* index, int resource, int process, int amount) {
+    int h = findHolding(index, resource, process);
+    if (h != -1) {
+        index->holdings[h].amount += amount;
+        if (index->holdings[h].amount <= 0) {
+            freeHolding(index, h);
+        }
+        return;
+    }
+    if (amount <= 0) {
+        return;
+    }
+
+    // the class's slice always has a free holding, see CLASS_HOLDERS
+    h = index->firstFree[resource];
+    holding* entry = &index->holdings[h];
+    processEntry* owner = &index->processes[process];
+    index->firstFree[resource] = entry->nextHeld;
+
+    entry->process = process;
+    entry->resource = resource;
+    entry->amount = amount;
+
+    entry->prevHeld = -1;
+    entry->nextHeld = owner->firstHeld;
+    if (owner->firstHeld != -1) {
+        index->holdings[owner->firstHeld].prevHeld = h;
+    }
+    owner->firstHeld = h;
+    owner->heldCount += 1;
+
+    entry->prevHolder = -1;
+    entry->nextHolder = index->firstHolder[resource];
+    if (index->firstHolder[resource] != -1) {
+        index->holdings[index->firstHolder[resource]].prevHolder = h;
+    }
+    index->firstHolder[resource] = h;
+    index->holderCount[resource] += 1;
+#ifdef UNROLLED_KERNELS
+    index->holderMask[resource] |= (uint64_t)1 << process;
+#endif
+}
+
+// Function to compare two waiters, ties go to the lower process index
+static inline int waiterBefore(const tableIndex* index, int a, int b) {
+    if (index->processes[a].waitKey != index->processes[b].waitKey) {
+        return index->processes[a].waitKey < index->processes[b].waitKey;
+    }
+    return a < b;
+}
+
+// Function to join two wait queue heaps, both roots must be unlinked
+// the root that goes first takes the other as its first child
+static inline int linkWaiters(tableIndex* index, int a, int b) {
+    if (a == -1) {
+        return b;
+    }
+    if (b == -1) {
+        return a;
+    }
+    if (waiterBefore(index, b, a)) {
+        int first = b;
+        b = a;
+        a = first;
+    }
+
+    processEntry* top = &index->processes[a];
+    processEntry* below = &index->processes[b];
+    below->heapSibling = top->heapChild;
+    if (top->heapChild != -1) {
+        index->processes[top->heapChild].heapPrev = b;
+    }
+    below->heapPrev = a;
+    top->heapChild = b;
+    return a;
+}
+
+// Function to join a list of sibling heaps into one
+// pairs are linked left to right, then the pairs right to left, which keeps pops O(log n) amortized
+static inline int mergeWaiterList(tableIndex* index, int first) {
+    int pairs = -1; // stack of joined pairs, chained through heapSibling
+    while (first != -1) {
+        int a = first;
+        int b = index->processes[a].heapSibling;
+        first = b == -1 ? -1 : index->processes[b].heapSibling;
+
+        index->processes[a].heapSibling = index->processes[a].heapPrev = -1;
+        if (b != -1) {
+            index->processes[b].heapSibling = index->processes[b].heapPrev = -1;
+        }
+
+        int joined = linkWaiters(index, a, b);
+        index->processes[joined].heapSibling = pairs;
+        pairs = joined;
+    }
+
+    int root = -1;
+    while (pairs != -1) {
+        int next = index->processes[pairs].heapSibling;
+        index->processes[pairs].heapSibling = -1;
+        root = linkWaiters(index, root, pairs);
+        pairs = next;
+    }
+    return root;
+}
+
+// Function to add a process to a resource's wait queue with its grant priority
+static inline void pushWaiter(tableIndex* index, int resource, int process, double key) {
+    processEntry* entry = &index->processes[process];
+    entry->waitingFor = resource;
+    entry->waitKey = key;
+    entry->heapChild = entry->heapSibling = entry->heapPrev = -1;
+
+    index->waiterRoot[resource] = linkWaiters(index, index->waiterRoot[resource], process);
+    index->waiterCount[resource] += 1;
+#ifdef UNROLLED_KERNELS
+    index->waiterMask[resource] |= (uint64_t)1 << process;
+#endif
+}
+
+// Function to take a waiting process out of its wait queue, wherever it is in the heap
+static inline void pullWaiter(tableIndex* index, int process) {
+    processEntry* entry = &index->processes[process];
+    int resource = entry->waitingFor;
+
+    // the children become one heap that takes the process's place
+    if (entry->heapChild != -1) {
+        index->processes[entry->heapChild].heapPrev = -1;
+    }
+    int children = mergeWaiterList(index, entry->heapChild);
+
+    if (index->waiterRoot[resource] == process) {
+        index->waiterRoot[resource] = children;
+    }
+    else {
+        int prev = entry->heapPrev;
+        if (index->processes[prev].heapChild == process) {
+            index->processes[prev].heapChild = entry->heapSibling;
+        }
+        else {
+            index->processes[prev].heapSibling = entry->heapSibling;
+        }
+        if (entry->heapSibling != -1) {
+            index->processes[entry->heapSibling].heapPrev = prev;
+        }
+        index->waiterRoot[resource] = linkWaiters(index, index->waiterRoot[resource], children);
+    }
+
+    entry->heapChild = entry->heapSibling = entry->heapPrev = -1;
+    entry->waitingFor = -1;
+    index->waiterCount[resource] -= 1;
+#ifdef UNROLLED_KERNELS
+    index->waiterMask[resource] &= ~((uint64_t)1 << process);
+#endif
+}
+
+#endif